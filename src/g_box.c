@@ -517,11 +517,30 @@ static int rt_arc_calculate_gbox_cartesian(const RTCTX *ctx, const RTPOINT4D *p1
   return rv;
 }
 
+/**
+* Extent of one split ordinate array of n > 0 values.
+*/
+static void
+ordinate_extent(const double *v, int n, double *min, double *max)
+{
+  double lo = v[0], hi = v[0];
+  int i;
+
+  for ( i = 1; i < n; i++ )
+  {
+    lo = FP_MIN(lo, v[i]);
+    hi = FP_MAX(hi, v[i]);
+  }
+  *min = lo;
+  *max = hi;
+}
+
 int ptarray_calculate_gbox_cartesian(const RTCTX *ctx, const RTPOINTARRAY *pa, RTGBOX *gbox )
 {
   int i;
   RTPOINT4D p;
   int has_z, has_m;
+  const RTPOINTARRAY_SOA *soa;
 
   if ( ! pa ) return RT_FAILURE;
   if ( ! gbox ) return RT_FAILURE;
@@ -532,6 +551,18 @@ int ptarray_calculate_gbox_cartesian(const RTCTX *ctx, const RTPOINTARRAY *pa, R
   gbox->flags = gflags(ctx, has_z, has_m, 0);
   RTDEBUGF(ctx, 4, "ptarray_calculate_gbox Z: %d M: %d", has_z, has_m);
 
+  soa = RT_ATOMIC_LOAD_PTR(&pa->soa);
+  if ( soa )
+  {
+    ordinate_extent(soa->x, pa->npoints, &gbox->xmin, &gbox->xmax);
+    ordinate_extent(soa->y, pa->npoints, &gbox->ymin, &gbox->ymax);
+    if ( has_z )
+      ordinate_extent(soa->z, pa->npoints, &gbox->zmin, &gbox->zmax);
+    if ( has_m )
+      ordinate_extent(soa->m, pa->npoints, &gbox->mmin, &gbox->mmax);
+    return RT_SUCCESS;
+  }
+
   rt_getPoint4d_p(ctx, pa, 0, &p);
   gbox->xmin = gbox->xmax = p.x;
   gbox->ymin = gbox->ymax = p.y;
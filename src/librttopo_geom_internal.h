@@ -50,6 +50,53 @@
 #include <ieeefp.h>
 #endif
 
+/* Interruption requests may come from signal handlers or other threads */
+#if defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L && !defined(__STDC_NO_ATOMICS__)
+#include <stdatomic.h>
+typedef atomic_int rtinterrupt_flag;
+#else
+#include <signal.h>
+typedef volatile sig_atomic_t rtinterrupt_flag;
+#endif
+
+/*
+* Atomic operations on plain integers and pointers, for geometries
+* read by several threads at once: reference counts, and publication
+* of the caches built on first use. RT_ATOMIC_PUBLISH(p, v) sets *p
+* to v if it is still NULL and tells whether it did. Without compiler
+* support they are plain operations, and sharing is unsafe.
+*/
+#if defined(__GNUC__)
+#define RT_ATOMIC_INC(p) __atomic_add_fetch((p), 1, __ATOMIC_RELAXED)
+#define RT_ATOMIC_DEC(p) __atomic_sub_fetch((p), 1, __ATOMIC_ACQ_REL)
+#define RT_ATOMIC_LOAD_PTR(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define RT_ATOMIC_PUBLISH(p, v) __extension__ ({ \
+  __typeof__(*(p)) rt_expected_ = NULL; \
+  __atomic_compare_exchange_n((p), &rt_expected_, (v), 0, \
+                              __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE); \
+})
+#elif defined(_MSC_VER)
+#include <intrin.h>
+#define RT_ATOMIC_INC(p) _InterlockedIncrement(p)
+#define RT_ATOMIC_DEC(p) _InterlockedDecrement(p)
+#define RT_ATOMIC_LOAD_PTR(p) (*(p))
+#define RT_ATOMIC_PUBLISH(p, v) \
+  (_InterlockedCompareExchangePointer((void * volatile *)(p), (v), NULL) == NULL)
+#else
+#define RT_ATOMIC_INC(p) (++*(p))
+#define RT_ATOMIC_DEC(p) (--*(p))
+#define RT_ATOMIC_LOAD_PTR(p) (*(p))
+#define RT_ATOMIC_PUBLISH(p, v) (*(p) ? 0 : ((*(p) = (v)), 1))
+#endif
+
+/*
+* Point array flag: part of a geometry given to rtgeom_share, whose
+* caches were built by the sharing context and are not to be built
+* by readers anymore. Never set on geometry flags.
+*/
+#define RTFLAGS_GET_SHARED(flags) (((flags) & 0x40)>>6)
+#define RTFLAGS_SET_SHARED(flags, value) ((flags) = (value) ? ((flags) | 0x40) : ((flags) & 0xBF))
+
 #if defined(PJ_VERSION) && PJ_VERSION >= 490
 /* Enable new geodesic functions */
 #define PROJ_GEODESIC 1
@@ -163,15 +210,43 @@
 struct RTCTX_T {
   GEOSContextHandle_t gctx;
   char rtgeom_geos_errmsg[RTGEOM_GEOS_ERRMSG_MAXSIZE];
-  rtallocator rtalloc_var;
-  rtreallocator rtrealloc_var;
-  rtfreeor rtfree_var;
+  rtallocator_r rtalloc_var;
+  rtreallocator_r rtrealloc_var;
+  rtfreeor_r rtfree_var;
+  void * alloc_arg;
+  /* callbacks given to rtgeom_init, called through alloc_arg = ctx */
+  rtallocator alloc_plain;
+  rtreallocator realloc_plain;
+  rtfreeor free_plain;
+  /* chunks of an rtgeom_init_arena context, NULL otherwise */
+  struct RTARENA_T * arena;
+  /* size class freelists of an rtgeom_init_pool context, NULL otherwise */
+  struct RTPOOL_T * pool;
   rtreporter error_logger;
   void * error_logger_arg;
   rtreporter notice_logger;
   void * notice_logger_arg;
   rtdebuglogger debug_logger;
   void * debug_logger_arg;
+  /* see rtgeom_request_interrupt */
+  rtinterrupt_flag interrupt_requested;
+  rtinterrupt_callback *interrupt_callback;
+  rtinterrupt_callback_r *interrupt_callback_r;
+  void * interrupt_callback_arg;
+  /* set by RT_ON_INTERRUPT, for callers telling interruption from errors */
+  int interrupted;
+  /* scratch memory of rt_dist2d_fast_ptarray_ptarray, grown on demand */
+  void * dist2d_scratch;
+  size_t dist2d_scratch_size;
+  /* bounding box cache counters, see rtgeom_bbox_stats */
+  RTBBOXSTATS bbox_stats;
+  /* callbacks wrapped by rtgeom_enable_memory_accounting, NULL otherwise */
+  rtallocator_r acct_alloc;
+  rtreallocator_r acct_realloc;
+  rtfreeor_r acct_free;
+  void * acct_arg;
+  size_t mem_limit;  /* 0 for none */
+  RTMEMSTATS mem_stats;
 };
 
 typedef struct
@@ -381,6 +456,13 @@ RTPOLY *rtpoly_clone_deep(const RTCTX *ctx, const RTPOLY *rtgeom);
 RTCOLLECTION *rtcollection_clone_deep(const RTCTX *ctx, const RTCOLLECTION *rtgeom);
 RTGBOX *gbox_clone(const RTCTX *ctx, const RTGBOX *gbox);
 
+/**
+* Cartesian box of a geometry, from its bbox cache when not geodetic.
+* The cached box may be slightly larger than the computed one, so this
+* is only fit for conservative tests.
+*/
+int rtgeom_get_bbox_cartesian(const RTCTX *ctx, const RTGEOM *rtg, RTGBOX *gbox);
+
 /*
 * Startpoint
 */
@@ -503,19 +585,35 @@ extern void trim_trailing_zeros(const RTCTX *ctx, char *num);
 
 extern uint8_t RTMULTITYPE[RTNUMTYPES];
 
-extern rtinterrupt_callback *_rtgeom_interrupt_callback;
-extern int _rtgeom_interrupt_requested;
+/**
+* Run the interrupt callbacks of the context, then tell whether
+* interruption was requested, leaving the request pending.
+*/
+#define RT_INTERRUPT_PENDING(ctx) ( \
+  ( (ctx)->interrupt_callback ? (*(ctx)->interrupt_callback)() : (void)0 ), \
+  ( (ctx)->interrupt_callback_r ? \
+    (*(ctx)->interrupt_callback_r)((ctx), (ctx)->interrupt_callback_arg) : (void)0 ), \
+  (ctx)->interrupt_requested )
+
+/**
+* Checkpoint of long loops: on interruption request, consume it
+* and run x, which should cleanup and return.
+*/
 #define RT_ON_INTERRUPT(x) { \
-  if ( _rtgeom_interrupt_callback ) { \
-    (*_rtgeom_interrupt_callback)(); \
-  } \
-  if ( _rtgeom_interrupt_requested ) { \
-    _rtgeom_interrupt_requested = 0; \
+  if ( RT_INTERRUPT_PENDING(ctx) ) { \
+    ((RTCTX *)ctx)->interrupt_requested = 0; \
+    ((RTCTX *)ctx)->interrupted = 1; \
     rtnotice(ctx, "librtgeom code interrupted"); \
     x; \
   } \
 }
 
+/**
+* Drop the derived geocentric and split coordinate caches of a point
+* array, to be called whenever its points change.
+*/
+void ptarray_caches_clear(const RTCTX *ctx, RTPOINTARRAY *pa);
+
 int ptarray_npoints_in_rect(const RTCTX *ctx, const RTPOINTARRAY *pa, const RTGBOX *gbox);
 int gbox_contains_point2d(const RTCTX *ctx, const RTGBOX *g, const RTPOINT2D *p);
 int rtpoly_contains_point(const RTCTX *ctx, const RTPOLY *poly, const RTPOINT2D *pt);
@@ -91,6 +91,7 @@ rt_dist2d_distanceline(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, i
   DISTPTS thedl;
   RTPOINT *rtpoints[2];
   RTGEOM *result;
+  int ret;
 
   thedl.mode = mode;
   thedl.distance = initdistance;
@@ -98,7 +99,10 @@ rt_dist2d_distanceline(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, i
 
   RTDEBUG(ctx, 2, "rt_dist2d_distanceline is called");
 
-  if (!rt_dist2d_comp(ctx,  rt1,rt2,&thedl))
+  ret = rt_dist2d_comp(ctx,  rt1,rt2,&thedl);
+  if (ret == DIST_INTERRUPTED)
+    return NULL;
+  if (!ret)
   {
     /*should never get here. all cases ought to be error handled earlier*/
     rterror(ctx, "Some unspecified error.");
@@ -136,6 +140,7 @@ rt_dist2d_distancepoint(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2,i
   DISTPTS thedl;
   double initdistance = FLT_MAX;
   RTGEOM *result;
+  int ret;
 
   thedl.mode = mode;
   thedl.distance= initdistance;
@@ -143,7 +148,10 @@ rt_dist2d_distancepoint(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2,i
 
   RTDEBUG(ctx, 2, "rt_dist2d_distancepoint is called");
 
-  if (!rt_dist2d_comp(ctx,  rt1,rt2,&thedl))
+  ret = rt_dist2d_comp(ctx,  rt1,rt2,&thedl);
+  if (ret == DIST_INTERRUPTED)
+    return NULL;
+  if (!ret)
   {
     /*should never get here. all cases ought to be error handled earlier*/
     rterror(ctx, "Some unspecified error.");
@@ -184,11 +192,15 @@ rtgeom_maxdistance2d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
 {
   /*double thedist;*/
   DISTPTS thedl;
+  int ret;
   RTDEBUG(ctx, 2, "rtgeom_maxdistance2d_tolerance is called");
   thedl.mode = DIST_MAX;
   thedl.distance= -1;
   thedl.tolerance = tolerance;
-  if (rt_dist2d_comp(ctx,  rt1,rt2,&thedl))
+  ret = rt_dist2d_comp(ctx,  rt1,rt2,&thedl);
+  if (ret == DIST_INTERRUPTED)
+    return -1;
+  if (ret)
   {
     return thedl.distance;
   }
@@ -215,11 +227,15 @@ double
 rtgeom_mindistance2d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, double tolerance)
 {
   DISTPTS thedl;
+  int ret;
   RTDEBUG(ctx, 2, "rtgeom_mindistance2d_tolerance is called");
   thedl.mode = DIST_MIN;
   thedl.distance= FLT_MAX;
   thedl.tolerance = tolerance;
-  if (rt_dist2d_comp(ctx,  rt1,rt2,&thedl))
+  ret = rt_dist2d_comp(ctx,  rt1,rt2,&thedl);
+  if (ret == DIST_INTERRUPTED)
+    return -1;
+  if (ret)
   {
     return thedl.distance;
   }
@@ -229,6 +245,112 @@ rtgeom_mindistance2d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
 }
 
 
+/**
+  Function handling min distance calculations between two indexed
+  geometries. Falls back to the brute force functions when any of
+  them could not be indexed.
+*/
+double
+rtgeom_rect_tree_mindistance2d_tolerance(const RTCTX *ctx, const RTRECTTREE *t1, const RTRECTTREE *t2, double tolerance)
+{
+  DISTPTS thedl;
+  RTDEBUG(ctx, 2, "rtgeom_rect_tree_mindistance2d_tolerance is called");
+
+  if ( ( ! t1->tree && ! rtgeom_is_empty(ctx, t1->geom) ) ||
+       ( ! t2->tree && ! rtgeom_is_empty(ctx, t2->geom) ) )
+  {
+    return rtgeom_mindistance2d_tolerance(ctx, t1->geom, t2->geom, tolerance);
+  }
+
+  rt_dist2d_distpts_init(ctx, &thedl, DIST_MIN);
+  thedl.tolerance = tolerance;
+  if (rt_dist2d_rect_tree(ctx, t1, t2, &thedl))
+  {
+    return thedl.distance;
+  }
+  /*should never get here. all cases ought to be error handled earlier*/
+  rterror(ctx, "Some unspecified error.");
+  return FLT_MAX;
+}
+
+double
+rtgeom_rect_tree_mindistance2d(const RTCTX *ctx, const RTRECTTREE *t1, const RTRECTTREE *t2)
+{
+  return rtgeom_rect_tree_mindistance2d_tolerance(ctx, t1, t2, 0.0);
+}
+
+/**
+  Function initializing indexed min distance calculation
+*/
+double
+rtgeom_mindistance2d_indexed(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2)
+{
+  RTRECTTREE *t1, *t2;
+  double dist;
+
+  RTDEBUG(ctx, 2, "rtgeom_mindistance2d_indexed is called");
+
+  t1 = rtgeom_rect_tree_create(ctx, rt1);
+  t2 = rtgeom_rect_tree_create(ctx, rt2);
+  dist = rtgeom_rect_tree_mindistance2d(ctx, t1, t2);
+  rtgeom_rect_tree_destroy(ctx, t1);
+  rtgeom_rect_tree_destroy(ctx, t2);
+
+  return dist;
+}
+
+/**
+  Function telling whether two geometries are within the given
+  distance of each other. Cheaper than comparing
+  rtgeom_mindistance2d_tolerance against the tolerance, as it gives up
+  on boxes farther apart and stops on the first pair close enough.
+*/
+int
+rtgeom_dwithin2d(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, double tolerance)
+{
+  RTGBOX box1, box2;
+  DISTPTS thedl;
+  int ret;
+
+  RTDEBUG(ctx, 2, "rtgeom_dwithin2d is called");
+
+  if ( tolerance < 0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero");
+    return RT_FALSE;
+  }
+
+  if ( rtgeom_is_empty(ctx, rt1) || rtgeom_is_empty(ctx, rt2) )
+    return RT_FALSE;
+
+  if ( rtgeom_get_bbox_cartesian(ctx, rt1, &box1) == RT_SUCCESS &&
+       rtgeom_get_bbox_cartesian(ctx, rt2, &box2) == RT_SUCCESS )
+  {
+    gbox_expand(ctx, &box1, tolerance);
+    if ( ! gbox_overlaps_2d(ctx, &box1, &box2) )
+      return RT_FALSE;
+  }
+
+  rt_dist2d_distpts_init(ctx, &thedl, DIST_MIN);
+  thedl.tolerance = tolerance;
+  /* Nothing farther than the tolerance matters, let it be pruned */
+  thedl.distance = tolerance + FP_TOLERANCE;
+
+  ret = rt_dist2d_comp(ctx, rt1, rt2, &thedl);
+  /* Not proven within: callers check for interruption themselves */
+  if ( ret == DIST_INTERRUPTED )
+    return RT_FALSE;
+  if ( ! ret )
+  {
+    /*should never get here. all cases ought to be error handled earlier*/
+    rterror(ctx, "Some unspecified error.");
+    return RT_FALSE;
+  }
+
+  return thedl.distance <= tolerance;
+}
+
+
 /*------------------------------------------------------------------------------------------------------------
 End of Initializing functions
 --------------------------------------------------------------------------------------------------------------*/
@@ -242,13 +364,21 @@ Functions preparing geometries for distance-calculations
   This function just deserializes geometries
   Bboxes is not checked here since it is the subgeometries
   bboxes we will use anyway.
+  Returns DIST_INTERRUPTED if interrupted, dl then only holds
+  the best candidate found so far.
 */
 int
 rt_dist2d_comp(const RTCTX *ctx, const RTGEOM *rt1,const RTGEOM *rt2, DISTPTS *dl)
 {
+  int ret;
   RTDEBUG(ctx, 2, "rt_dist2d_comp is called");
 
-  return rt_dist2d_recursive(ctx, rt1, rt2, dl);
+  ret = rt_dist2d_recursive(ctx, rt1, rt2, dl);
+
+  /* Interrupted searches unwind early, consume the request */
+  RT_ON_INTERRUPT(return DIST_INTERRUPTED);
+
+  return ret;
 }
 
 static int
@@ -323,6 +453,8 @@ int rt_dist2d_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2
     }
     for ( j = 0; j < n2; j++ )
     {
+      if ( RT_INTERRUPT_PENDING(ctx) ) return RT_TRUE;
+
       if (rt_dist2d_is_collection(ctx, rtg2))
       {
         g2 = c2->geoms[j];
@@ -350,6 +482,13 @@ int rt_dist2d_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2
       /*If one of geometries is empty, return. True here only means continue searching. False would have stoped the process*/
       if (rtgeom_is_empty(ctx, g1)||rtgeom_is_empty(ctx, g2)) return RT_TRUE;
 
+      /*Nothing in there can be closer than what we already have*/
+      if ( (dl->mode == DIST_MIN) && rt_dist2d_check_distance(ctx, g1, g2) > dl->distance )
+      {
+        RTDEBUG(ctx, 3, "bboxes farther than current min distance, skipping");
+        continue;
+      }
+
       if ( (dl->mode != DIST_MAX) &&
          (! rt_dist2d_check_overlap(ctx, g1, g2)) &&
            (g1->type == RTLINETYPE || g1->type == RTPOLYGONTYPE) &&
@@ -501,9 +640,9 @@ rt_dist2d_check_overlap(const RTCTX *ctx, RTGEOM *rtg1,RTGEOM *rtg2)
 {
   RTDEBUG(ctx, 2, "rt_dist2d_check_overlap is called");
   if ( ! rtg1->bbox )
-    rtgeom_calculate_gbox(ctx, rtg1, rtg1->bbox);
+    rtgeom_add_bbox(ctx, rtg1);
   if ( ! rtg2->bbox )
-    rtgeom_calculate_gbox(ctx, rtg2, rtg2->bbox);
+    rtgeom_add_bbox(ctx, rtg2);
 
   /*Check if the geometries intersect.
   */
@@ -516,6 +655,28 @@ rt_dist2d_check_overlap(const RTCTX *ctx, RTGEOM *rtg1,RTGEOM *rtg2)
   return RT_TRUE;
 }
 
+/**
+Min distance between the bboxes of two geometries, zero when they overlap.
+Geodetic bboxes are not comparable, zero is returned for them too.
+*/
+double
+rt_dist2d_check_distance(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2)
+{
+  const RTGBOX *b1 = rtg1->bbox;
+  const RTGBOX *b2 = rtg2->bbox;
+  double dx, dy;
+
+  if ( ! b1 || ! b2 || RTFLAGS_GET_GEODETIC(b1->flags) || RTFLAGS_GET_GEODETIC(b2->flags) )
+    return 0.0;
+
+  dx = FP_MAX(b1->xmin - b2->xmax, b2->xmin - b1->xmax);
+  dy = FP_MAX(b1->ymin - b2->ymax, b2->ymin - b1->ymax);
+  if ( dx < 0.0 ) dx = 0.0;
+  if ( dy < 0.0 ) dy = 0.0;
+
+  return sqrt(dx*dx + dy*dy);
+}
+
 /**
 
 Here the geometries are distributed for the new faster distance-calculations
@@ -1043,6 +1204,89 @@ rt_dist2d_curvepoly_curvepoly(const RTCTX *ctx, RTCURVEPOLY *poly1, RTCURVEPOLY
 
 
 
+/**
+* Squared distance from point (px,py) to segment (ax,ay)-(bx,by).
+* Branch-light so that loops over many segments can be vectorized
+* by the compiler.
+*/
+static inline double
+rt_seg_dist_sqr(double px, double py, double ax, double ay, double bx, double by)
+{
+  double dx = bx - ax;
+  double dy = by - ay;
+  double len2 = dx*dx + dy*dy;
+  double r = 0.0;
+
+  px -= ax;
+  py -= ay;
+  if ( len2 > 0.0 )
+  {
+    r = (px*dx + py*dy) / len2;
+    r = r < 0.0 ? 0.0 : ( r > 1.0 ? 1.0 : r );
+  }
+  px -= r*dx;
+  py -= r*dy;
+  return px*px + py*py;
+}
+
+/**
+* Search the segment of pa closest to p, reading the coordinates
+* straight from the serialized point list.
+* Returns the index of the first vertex of that segment, and
+* its squared distance in dist_sqr if not NULL.
+* pa must have at least two points.
+*/
+static int
+rt_dist2d_pt_ptarray_closest_seg(const RTCTX *ctx, const RTPOINT2D *p, const RTPOINTARRAY *pa, double *dist_sqr)
+{
+  const double *pts = (const double*)pa->serialized_pointlist;
+  int stride = RTFLAGS_NDIMS(pa->flags);
+  int nsegs = pa->npoints - 1;
+  double px = p->x, py = p->y;
+  double d, best = FLT_MAX;
+  int i, besti = 0;
+
+  for ( i = 0; i < nsegs; i++, pts += stride )
+  {
+    d = rt_seg_dist_sqr(px, py, pts[0], pts[1], pts[stride], pts[stride+1]);
+    if ( d < best )
+    {
+      best = d;
+      besti = i;
+    }
+  }
+
+  if ( dist_sqr ) *dist_sqr = best;
+  return besti;
+}
+
+/**
+* Whether segments AB and CD properly cross each other.
+* Touching and overlapping segments are not reported, since
+* a vertex of one of them is then on the other.
+*/
+static int
+rt_dist2d_seg_cross(const RTPOINT2D *A, const RTPOINT2D *B, const RTPOINT2D *C, const RTPOINT2D *D)
+{
+  double ab_c, ab_d, cd_a, cd_b;
+
+  if ( FP_MAX(A->x, B->x) < FP_MIN(C->x, D->x) || FP_MAX(C->x, D->x) < FP_MIN(A->x, B->x) ||
+       FP_MAX(A->y, B->y) < FP_MIN(C->y, D->y) || FP_MAX(C->y, D->y) < FP_MIN(A->y, B->y) )
+    return RT_FALSE;
+
+  ab_c = (B->x - A->x) * (C->y - A->y) - (B->y - A->y) * (C->x - A->x);
+  ab_d = (B->x - A->x) * (D->y - A->y) - (B->y - A->y) * (D->x - A->x);
+  if ( ( ab_c >= 0.0 && ab_d >= 0.0 ) || ( ab_c <= 0.0 && ab_d <= 0.0 ) )
+    return RT_FALSE;
+
+  cd_a = (D->x - C->x) * (A->y - C->y) - (D->y - C->y) * (A->x - C->x);
+  cd_b = (D->x - C->x) * (B->y - C->y) - (D->y - C->y) * (B->x - C->x);
+  if ( ( cd_a >= 0.0 && cd_b >= 0.0 ) || ( cd_a <= 0.0 && cd_b <= 0.0 ) )
+    return RT_FALSE;
+
+  return RT_TRUE;
+}
+
 /**
  * search all the segments of pointarray to see which one is closest to p1
  * Returns minimum distance between point and pointarray
@@ -1056,6 +1300,12 @@ rt_dist2d_pt_ptarray(const RTCTX *ctx, const RTPOINT2D *p, RTPOINTARRAY *pa,DIST
 
   RTDEBUG(ctx, 2, "rt_dist2d_pt_ptarray is called");
 
+  if ( dl->mode == DIST_MIN && pa->npoints > 1 )
+  {
+    t = rt_dist2d_pt_ptarray_closest_seg(ctx, p, pa, NULL);
+    return rt_dist2d_pt_seg(ctx, p, rt_getPoint2d_cp(ctx, pa, t), rt_getPoint2d_cp(ctx, pa, t+1), dl);
+  }
+
   start = rt_getPoint2d_cp(ctx, pa, 0);
 
   if ( !rt_dist2d_pt_pt(ctx, p, start, dl) ) return RT_FALSE;
@@ -1143,6 +1393,7 @@ rt_dist2d_ptarray_ptarray(const RTCTX *ctx, RTPOINTARRAY *l1, RTPOINTARRAY *l2,D
   {
     for (t=0; t<l1->npoints; t++) /*for each segment in L1 */
     {
+      if ( RT_INTERRUPT_PENDING(ctx) ) return RT_TRUE;
       start = rt_getPoint2d_cp(ctx, l1, t);
       for (u=0; u<l2->npoints; u++) /*for each segment in L2 */
       {
@@ -1154,26 +1405,57 @@ rt_dist2d_ptarray_ptarray(const RTCTX *ctx, RTPOINTARRAY *l1, RTPOINTARRAY *l2,D
       }
     }
   }
-  else
+  else if (l1->npoints > 1 && l2->npoints > 1)
   {
-    start = rt_getPoint2d_cp(ctx, l1, 0);
-    for (t=1; t<l1->npoints; t++) /*for each segment in L1 */
+    /*
+     * Unless the lines cross, the min distance is between a vertex
+     * of one of them and a segment of the other.
+     */
+    double d, dmin = FLT_MAX;
+    int vt = 0, vu = 0, vtwist = twist;
+
+    for (t=0; t<l1->npoints; t++) /*each vertex of L1 against L2 */
     {
-      end = rt_getPoint2d_cp(ctx, l1, t);
-      start2 = rt_getPoint2d_cp(ctx, l2, 0);
-      for (u=1; u<l2->npoints; u++) /*for each segment in L2 */
+      if ( RT_INTERRUPT_PENDING(ctx) ) return RT_TRUE;
+      u = rt_dist2d_pt_ptarray_closest_seg(ctx, rt_getPoint2d_cp(ctx, l1, t), l2, &d);
+      if (d < dmin) { dmin = d; vt = t; vu = u; vtwist = twist; }
+    }
+    for (u=0; u<l2->npoints; u++) /*each vertex of L2 against L1 */
+    {
+      if ( RT_INTERRUPT_PENDING(ctx) ) return RT_TRUE;
+      t = rt_dist2d_pt_ptarray_closest_seg(ctx, rt_getPoint2d_cp(ctx, l2, u), l1, &d);
+      if (d < dmin) { dmin = d; vt = u; vu = t; vtwist = -twist; }
+    }
+    RTDEBUGF(ctx, 3, " closest vertex-segment dist: %f", sqrt(dmin));
+
+    if (dmin > dl->tolerance * dl->tolerance)
+    {
+      start = rt_getPoint2d_cp(ctx, l1, 0);
+      for (t=1; t<l1->npoints; t++) /*for each segment in L1 */
       {
-        end2 = rt_getPoint2d_cp(ctx, l2, u);
-        dl->twisted=twist;
-        rt_dist2d_seg_seg(ctx, start, end, start2, end2, dl);
-        RTDEBUGF(ctx, 4, "mindist_ptarray_ptarray; seg %i * seg %i, dist = %g\n",t,u,dl->distance);
-        RTDEBUGF(ctx, 3, " seg%d-seg%d dist: %f, mindist: %f",
-                 t, u, dl->distance, dl->tolerance);
-        if (dl->distance<=dl->tolerance && dl->mode == DIST_MIN) return RT_TRUE; /*just a check if  the answer is already given*/
-        start2 = end2;
+        if ( RT_INTERRUPT_PENDING(ctx) ) return RT_TRUE;
+        end = rt_getPoint2d_cp(ctx, l1, t);
+        start2 = rt_getPoint2d_cp(ctx, l2, 0);
+        for (u=1; u<l2->npoints; u++) /*for each segment in L2 */
+        {
+          end2 = rt_getPoint2d_cp(ctx, l2, u);
+          if (rt_dist2d_seg_cross(start, end, start2, end2))
+          {
+            RTDEBUGF(ctx, 3, " seg%d-seg%d cross", t, u);
+            dl->twisted=twist;
+            return rt_dist2d_seg_seg(ctx, start, end, start2, end2, dl);
+          }
+          start2 = end2;
+        }
+        start = end;
       }
-      start = end;
     }
+
+    dl->twisted = vtwist;
+    if (vtwist == twist)
+      return rt_dist2d_pt_seg(ctx, rt_getPoint2d_cp(ctx, l1, vt), rt_getPoint2d_cp(ctx, l2, vu), rt_getPoint2d_cp(ctx, l2, vu+1), dl);
+    else
+      return rt_dist2d_pt_seg(ctx, rt_getPoint2d_cp(ctx, l2, vt), rt_getPoint2d_cp(ctx, l1, vu), rt_getPoint2d_cp(ctx, l1, vu+1), dl);
   }
   return RT_TRUE;
 }
@@ -1781,6 +2063,100 @@ End of Brute force functions
 New faster distance calculations
 --------------------------------------------------------------------------------------------------------------*/
 
+/**
+  Scratch lists for rt_dist2d_fast_ptarray_ptarray.
+  They are kept in the context and only ever grown, so that
+  repeated distance calculations do not allocate.
+*/
+static LISTSTRUCT *
+rt_dist2d_fast_scratch(const RTCTX *ctx, size_t n)
+{
+  RTCTX *wctx = (RTCTX *)ctx;
+  size_t size = sizeof(LISTSTRUCT) * n;
+
+  if ( size > ctx->dist2d_scratch_size )
+  {
+    if ( ctx->dist2d_scratch )
+      rtfree(ctx, ctx->dist2d_scratch);
+    /* leave some room for growth */
+    size += size / 2;
+    wctx->dist2d_scratch = rtalloc(ctx, size);
+    wctx->dist2d_scratch_size = size;
+  }
+  return ctx->dist2d_scratch;
+}
+
+/**
+  Map a double to an unsigned integer of the same ordering
+*/
+static inline uint64_t
+rt_dist2d_measure_key(double measure)
+{
+  uint64_t u;
+  memcpy(&u, &measure, sizeof(u));
+  return ( u & 0x8000000000000000ULL ) ? ~u : ( u | 0x8000000000000000ULL );
+}
+
+/**
+  Sort a list by measure, ascending.
+  Short lists get an insertion sort, longer ones a radix sort
+  on the bytes of the measures, using tmp (of n items) as buffer.
+*/
+static void
+rt_dist2d_sort_by_measure(LISTSTRUCT *list, LISTSTRUCT *tmp, int n)
+{
+  int count[8][256];
+  LISTSTRUCT *src = list, *dst = tmp, *swap, item;
+  uint64_t key;
+  int i, j, b, pos, c;
+
+  if ( n < 64 )
+  {
+    for ( i = 1; i < n; i++ )
+    {
+      item = list[i];
+      for ( j = i; j > 0 && list[j-1].themeasure > item.themeasure; j-- )
+        list[j] = list[j-1];
+      list[j] = item;
+    }
+    return;
+  }
+
+  memset(count, 0, sizeof(count));
+  for ( i = 0; i < n; i++ )
+  {
+    key = rt_dist2d_measure_key(list[i].themeasure);
+    for ( b = 0; b < 8; b++ )
+      count[b][(key >> (8*b)) & 0xFF]++;
+  }
+
+  for ( b = 0; b < 8; b++ )
+  {
+    /* All items share this byte, nothing to do */
+    key = rt_dist2d_measure_key(src[0].themeasure);
+    if ( count[b][(key >> (8*b)) & 0xFF] == n )
+      continue;
+
+    for ( pos = 0, j = 0; j < 256; j++ )
+    {
+      c = count[b][j];
+      count[b][j] = pos;
+      pos += c;
+    }
+    for ( i = 0; i < n; i++ )
+    {
+      key = rt_dist2d_measure_key(src[i].themeasure);
+      dst[count[b][(key >> (8*b)) & 0xFF]++] = src[i];
+    }
+    swap = src;
+    src = dst;
+    dst = swap;
+  }
+
+  if ( src != list )
+    memcpy(list, src, sizeof(LISTSTRUCT) * n);
+}
+
 /**
 
 The new faster calculation comparing pointarray to another pointarray
@@ -1802,9 +2178,10 @@ rt_dist2d_fast_ptarray_ptarray(const RTCTX *ctx, RTPOINTARRAY *l1, RTPOINTARRAY
   int n1 = l1->npoints;
   int n2 = l2->npoints;
 
-  LISTSTRUCT *list1, *list2;
-  list1 = (LISTSTRUCT*)rtalloc(ctx, sizeof(LISTSTRUCT)*n1);
-  list2 = (LISTSTRUCT*)rtalloc(ctx, sizeof(LISTSTRUCT)*n2);
+  LISTSTRUCT *list1, *list2, *tmp;
+  list1 = rt_dist2d_fast_scratch(ctx, n1 + n2 + FP_MAX(n1, n2));
+  list2 = list1 + n1;
+  tmp = list2 + n2;
 
   RTDEBUG(ctx, 2, "rt_dist2d_fast_ptarray_ptarray is called");
 
@@ -1878,30 +2255,20 @@ rt_dist2d_fast_ptarray_ptarray(const RTCTX *ctx, RTPOINTARRAY *l1, RTPOINTARRAY
   }
 
   /*we sort our lists by the calculated values*/
-  qsort(list1, n1, sizeof(LISTSTRUCT), struct_cmp_by_measure);
-  qsort(list2, n2, sizeof(LISTSTRUCT), struct_cmp_by_measure);
+  rt_dist2d_sort_by_measure(list1, tmp, n1);
+  rt_dist2d_sort_by_measure(list2, tmp, n2);
 
   if (c1m < c2m)
   {
     if (!rt_dist2d_pre_seg_seg(ctx, l1,l2,list1,list2,k,dl))
-    {
-      rtfree(ctx, list1);
-      rtfree(ctx, list2);
       return RT_FALSE;
-    }
   }
   else
   {
     dl->twisted= ((dl->twisted) * (-1));
     if (!rt_dist2d_pre_seg_seg(ctx, l2,l1,list2,list1,k,dl))
-    {
-      rtfree(ctx, list1);
-      rtfree(ctx, list2);
       return RT_FALSE;
-    }
   }
-  rtfree(ctx, list1);
-  rtfree(ctx, list2);
   return RT_TRUE;
 }
 
@@ -1938,6 +2305,7 @@ rt_dist2d_pre_seg_seg(const RTCTX *ctx, RTPOINTARRAY *l1, RTPOINTARRAY *l2,LISTS
     point closer to our perpendicular "checkline" than
     our shortest found distance*/
     if (((list2[0].themeasure-list1[i].themeasure)) > maxmeasure) break;
+    if ( RT_INTERRUPT_PENDING(ctx) ) return RT_TRUE;
     for (r=-1; r<=1; r +=2) /*because we are not iterating in the original pointorder we have to check the segment before and after every point*/
     {
       pnr1 = list1[i].pnr;
@@ -2038,6 +2406,140 @@ End of New faster distance calculations
 --------------------------------------------------------------------------------------------------------------*/
 
 
+/*------------------------------------------------------------------------------------------------------------
+Indexed distance calculations
+Branch and bound search between the rect trees of two geometries
+--------------------------------------------------------------------------------------------------------------*/
+
+/**
+  Min or max distance between two indexed geometries.
+  If a component of one geometry has a vertex inside an area of the
+  other the min distance is zero, otherwise it is the distance between
+  their edges.
+*/
+int
+rt_dist2d_rect_tree(const RTCTX *ctx, const RTRECTTREE *t1, const RTRECTTREE *t2, DISTPTS *dl)
+{
+  int i;
+
+  RTDEBUG(ctx, 2, "rt_dist2d_rect_tree is called");
+
+  /* Empty geometries, nothing to measure */
+  if ( ! t1->tree || ! t2->tree )
+    return RT_TRUE;
+
+  if ( dl->mode == DIST_MIN )
+  {
+    for ( i = 0; i < t2->ncomps; i++ )
+    {
+      if ( rect_tree_geom_contains_point(ctx, t1, t2->comps[i]) != RT_OUTSIDE )
+      {
+        dl->distance = 0.0;
+        dl->p1 = dl->p2 = *(t2->comps[i]);
+        return RT_TRUE;
+      }
+    }
+    for ( i = 0; i < t1->ncomps; i++ )
+    {
+      if ( rect_tree_geom_contains_point(ctx, t2, t1->comps[i]) != RT_OUTSIDE )
+      {
+        dl->distance = 0.0;
+        dl->p1 = dl->p2 = *(t1->comps[i]);
+        return RT_TRUE;
+      }
+    }
+  }
+
+  return rt_dist2d_rect_node(ctx, t1->tree, t2->tree, dl);
+}
+
+/**
+  Box distance between two nodes to compare with dl->distance:
+  the closest possible one for mindistance, the farthest possible
+  one for maxdistance.
+*/
+static double
+rt_dist2d_rect_node_bound(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2, int mode)
+{
+  if ( mode == DIST_MIN )
+    return rect_node_distance(ctx, n1, n2);
+  return rect_node_max_distance(ctx, n1, n2);
+}
+
+/**
+  Recursive descent of two rect trees, pruning node pairs whose boxes
+  cannot improve the distance found so far, and visiting the most
+  promising pair of children first.
+*/
+int
+rt_dist2d_rect_node(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2, DISTPTS *dl)
+{
+  const RECT_NODE *a1, *a2, *b1, *b2;
+  double d1, d2;
+
+  /*multiplication with mode to handle mindistance (mode=1) and maxdistance (mode = (-1)*/
+  if ( (dl->distance - rt_dist2d_rect_node_bound(ctx, n1, n2, dl->mode)) * dl->mode < 0 )
+    return RT_TRUE;
+
+  /* Two edges (or points), compute the actual distance */
+  if ( n1->p1 && n2->p1 )
+  {
+    dl->twisted = 1;
+    if ( dl->mode == DIST_MIN )
+      return rt_dist2d_seg_seg(ctx, n1->p1, n1->p2, n2->p1, n2->p2, dl);
+
+    /* Max distance is always between vertices */
+    rt_dist2d_pt_pt(ctx, n1->p1, n2->p1, dl);
+    rt_dist2d_pt_pt(ctx, n1->p1, n2->p2, dl);
+    rt_dist2d_pt_pt(ctx, n1->p2, n2->p1, dl);
+    return rt_dist2d_pt_pt(ctx, n1->p2, n2->p2, dl);
+  }
+
+  /* Split the internal node with the biggest box */
+  if ( n2->p1 || ( ! n1->p1 &&
+       (n1->xmax - n1->xmin) + (n1->ymax - n1->ymin) >=
+       (n2->xmax - n2->xmin) + (n2->ymax - n2->ymin) ) )
+  {
+    a1 = n1->left_node;
+    b1 = n1->right_node;
+    a2 = b2 = n2;
+    d1 = rt_dist2d_rect_node_bound(ctx, n1->left_node, n2, dl->mode);
+    d2 = rt_dist2d_rect_node_bound(ctx, n1->right_node, n2, dl->mode);
+    if ( (d2 - d1) * dl->mode < 0 )
+    {
+      a1 = n1->right_node;
+      b1 = n1->left_node;
+    }
+  }
+  else
+  {
+    a1 = b1 = n1;
+    a2 = n2->left_node;
+    b2 = n2->right_node;
+    d1 = rt_dist2d_rect_node_bound(ctx, n1, n2->left_node, dl->mode);
+    d2 = rt_dist2d_rect_node_bound(ctx, n1, n2->right_node, dl->mode);
+    if ( (d2 - d1) * dl->mode < 0 )
+    {
+      a2 = n2->right_node;
+      b2 = n2->left_node;
+    }
+  }
+
+  if ( ! rt_dist2d_rect_node(ctx, a1, a2, dl) )
+    return RT_FALSE;
+
+  /* just a check if the answer is already given */
+  if ( dl->mode == DIST_MIN && dl->distance <= dl->tolerance )
+    return RT_TRUE;
+
+  return rt_dist2d_rect_node(ctx, b1, b2, dl);
+}
+
+/*------------------------------------------------------------------------------------------------------------
+End of Indexed distance calculations
+--------------------------------------------------------------------------------------------------------------*/
+
+
 /*------------------------------------------------------------------------------------------------------------
 Functions in common for Brute force and new calculation
 --------------------------------------------------------------------------------------------------------------*/
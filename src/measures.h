@@ -37,11 +37,15 @@
  **********************************************************************/
 
 #include "librttopo_geom_internal.h"
+#include "rttree.h"
 
 /* for the measure functions*/
 #define DIST_MAX    -1
 #define DIST_MIN    1
 
+/* rt_dist2d_comp return value for interrupted searches */
+#define DIST_INTERRUPTED -1
+
 /**
 * Structure used in distance-calculations
 */
@@ -69,6 +73,7 @@ int rt_dist2d_comp(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, DISTP
 int rt_dist2d_distribute_bruteforce(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS *dl);
 int rt_dist2d_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS *dl);
 int rt_dist2d_check_overlap(const RTCTX *ctx, RTGEOM *rtg1, RTGEOM *rtg2);
+double rt_dist2d_check_distance(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2);
 int rt_dist2d_distribute_fast(const RTCTX *ctx, RTGEOM *rtg1, RTGEOM *rtg2, DISTPTS *dl);
 
 /*
@@ -104,6 +109,24 @@ int rt_dist2d_selected_seg_seg(const RTCTX *ctx, const RTPOINT2D *A, const RTPOI
 int struct_cmp_by_measure(const void *a, const void *b);
 int rt_dist2d_fast_ptarray_ptarray(const RTCTX *ctx, RTPOINTARRAY *l1,RTPOINTARRAY *l2, DISTPTS *dl,  RTGBOX *box1, RTGBOX *box2);
 
+/*
+* Indexed distance calculations
+*/
+int rt_dist2d_rect_tree(const RTCTX *ctx, const RTRECTTREE *t1, const RTRECTTREE *t2, DISTPTS *dl);
+int rt_dist2d_rect_node(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2, DISTPTS *dl);
+
+/**
+* A geometry prepared for repeated 2D measurements.
+* See rtgeom_prepare.
+*/
+struct RTPREPARED
+{
+  const RTGEOM *geom;   /* source geometry */
+  RTGBOX gbox;          /* 2D extent, only valid if has_gbox */
+  int has_gbox;         /* RT_FALSE for empty geometries */
+  RTRECTTREE *tree;     /* edge index */
+};
+
 /*
 * Distance calculation primitives.
 */
@@ -41,6 +41,7 @@
 #include <stdlib.h>
 
 #include "measures3d.h"
+#include "rttree3d.h"
 #include "rtgeom_log.h"
 
 
@@ -118,6 +119,7 @@ rt_dist3d_distanceline(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, i
   DISTPTS3D thedl;
   RTPOINT *rtpoints[2];
   RTGEOM *result;
+  int ret;
 
   thedl.mode = mode;
   thedl.distance = initdistance;
@@ -138,7 +140,10 @@ rt_dist3d_distanceline(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, i
     thedl2d.mode = mode;
     thedl2d.distance = initdistance;
     thedl2d.tolerance = 0.0;
-    if (!rt_dist2d_comp(ctx,  rt1,rt2,&thedl2d))
+    ret = rt_dist2d_comp(ctx,  rt1,rt2,&thedl2d);
+    if (ret == DIST_INTERRUPTED)
+      return NULL;
+    if (!ret)
     {
       /*should never get here. all cases ought to be error handled earlier*/
       rterror(ctx, "Some unspecified error.");
@@ -221,6 +226,7 @@ rt_dist3d_distancepoint(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2,
   DISTPTS3D thedl;
   double initdistance = FLT_MAX;
   RTGEOM *result;
+  int ret;
 
   thedl.mode = mode;
   thedl.distance= initdistance;
@@ -243,7 +249,10 @@ rt_dist3d_distancepoint(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2,
     thedl2d.mode = mode;
     thedl2d.distance = initdistance;
     thedl2d.tolerance = 0.0;
-    if (!rt_dist2d_comp(ctx,  rt1,rt2,&thedl2d))
+    ret = rt_dist2d_comp(ctx,  rt1,rt2,&thedl2d);
+    if (ret == DIST_INTERRUPTED)
+      return NULL;
+    if (!ret)
     {
       /*should never get here. all cases ought to be error handled earlier*/
       rterror(ctx, "Some unspecified error.");
@@ -348,6 +357,22 @@ rtgeom_maxdistance3d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
   return -1;
 }
 
+/**
+* Above this many vertex pairs, rtgeom_mindistance3d and
+* rtgeom_dwithin3d index their inputs rather than testing
+* every pair of edges.
+*/
+#define AABB_TREE_MIN_PAIRS 1024
+
+static double rt_dist3d_mindistance_bruteforce(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, double tolerance);
+static int rt_dist3d_gbox_far(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl);
+
+static int
+rt_dist3d_worth_indexing(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2)
+{
+  return (double)rtgeom_count_vertices(ctx, rt1) * rtgeom_count_vertices(ctx, rt2) > AABB_TREE_MIN_PAIRS;
+}
+
 /**
   Function initializing 3d min distance calculation
 */
@@ -371,8 +396,29 @@ rtgeom_mindistance3d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
 
     return rtgeom_mindistance2d_tolerance(ctx, rt1, rt2, tolerance);
   }
-  DISTPTS3D thedl;
   RTDEBUG(ctx, 2, "rtgeom_mindistance3d_tolerance is called");
+
+  if ( rt_dist3d_worth_indexing(ctx, rt1, rt2) )
+  {
+    RTAABBTREE *t1 = rtgeom_aabb_tree_create(ctx, rt1);
+    RTAABBTREE *t2 = rtgeom_aabb_tree_create(ctx, rt2);
+    double dist = rtgeom_aabb_tree_mindistance3d_tolerance(ctx, t1, t2, tolerance);
+    rtgeom_aabb_tree_destroy(ctx, t1);
+    rtgeom_aabb_tree_destroy(ctx, t2);
+    return dist;
+  }
+
+  return rt_dist3d_mindistance_bruteforce(ctx, rt1, rt2, tolerance);
+}
+
+/**
+  Function handling 3d min distance calculations on all pairs
+  of components of two geometries.
+*/
+static double
+rt_dist3d_mindistance_bruteforce(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, double tolerance)
+{
+  DISTPTS3D thedl;
   thedl.mode = DIST_MIN;
   thedl.distance= FLT_MAX;
   thedl.tolerance = tolerance;
@@ -385,6 +431,155 @@ rtgeom_mindistance3d_tolerance(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM
   return FLT_MAX;
 }
 
+/**
+  Function telling whether two geometries are within the given 3d
+  distance of each other, skipping pairs of components whose boxes
+  are farther apart and stopping on the first pair close enough.
+*/
+int
+rtgeom_dwithin3d(const RTCTX *ctx, const RTGEOM *rt1, const RTGEOM *rt2, double tolerance)
+{
+  DISTPTS3D thedl;
+
+  if ( tolerance < 0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero");
+    return RT_FALSE;
+  }
+
+  if(!rtgeom_has_z(ctx, rt1) || !rtgeom_has_z(ctx, rt2))
+  {
+    rtnotice(ctx, "One or both of the geometries is missing z-value. The unknown z-value will be regarded as \"any value\"");
+    return rtgeom_dwithin2d(ctx, rt1, rt2, tolerance);
+  }
+  RTDEBUG(ctx, 2, "rtgeom_dwithin3d is called");
+
+  if ( rtgeom_is_empty(ctx, rt1) || rtgeom_is_empty(ctx, rt2) )
+    return RT_FALSE;
+
+  if ( rt_dist3d_worth_indexing(ctx, rt1, rt2) )
+  {
+    RTAABBTREE *t1, *t2;
+    int within;
+
+    thedl.distance = tolerance;
+    if ( rt_dist3d_gbox_far(ctx, rt1, rt2, &thedl) )
+      return RT_FALSE;
+
+    t1 = rtgeom_aabb_tree_create(ctx, rt1);
+    t2 = rtgeom_aabb_tree_create(ctx, rt2);
+    within = rtgeom_aabb_tree_dwithin3d(ctx, t1, t2, tolerance);
+    rtgeom_aabb_tree_destroy(ctx, t1);
+    rtgeom_aabb_tree_destroy(ctx, t2);
+    return within;
+  }
+
+  thedl.mode = DIST_MIN;
+  thedl.twisted = 1;
+  /* Nothing farther than the tolerance matters, let it be pruned */
+  thedl.distance = tolerance + FP_TOLERANCE;
+  thedl.tolerance = tolerance;
+  if (rt_dist3d_dwithin_recursive(ctx, rt1, rt2, &thedl))
+  {
+    return thedl.distance <= tolerance;
+  }
+  /*should never get here. all cases ought to be error handled earlier*/
+  rterror(ctx, "Some unspecified error.");
+  return RT_FALSE;
+}
+
+/**
+  Whether an indexed geometry is usable as such: a geometry which
+  could not be indexed has no tree, but is not empty.
+*/
+static int
+rt_dist3d_aabb_tree_usable(const RTCTX *ctx, const RTAABBTREE *tree)
+{
+  return tree->tree || rtgeom_is_empty(ctx, tree->geom);
+}
+
+/**
+  Function handling min distance calculations between two indexed
+  geometries. Falls back to the brute force functions when any of
+  them could not be indexed.
+*/
+double
+rtgeom_aabb_tree_mindistance3d_tolerance(const RTCTX *ctx, const RTAABBTREE *t1, const RTAABBTREE *t2, double tolerance)
+{
+  DISTPTS3D thedl;
+
+  if(!rtgeom_has_z(ctx, t1->geom) || !rtgeom_has_z(ctx, t2->geom))
+  {
+    rtnotice(ctx, "One or both of the geometries is missing z-value. The unknown z-value will be regarded as \"any value\"");
+    return rtgeom_mindistance2d_tolerance(ctx, t1->geom, t2->geom, tolerance);
+  }
+  RTDEBUG(ctx, 2, "rtgeom_aabb_tree_mindistance3d_tolerance is called");
+
+  if ( ! rt_dist3d_aabb_tree_usable(ctx, t1) || ! rt_dist3d_aabb_tree_usable(ctx, t2) )
+    return rt_dist3d_mindistance_bruteforce(ctx, t1->geom, t2->geom, tolerance);
+
+  thedl.mode = DIST_MIN;
+  thedl.twisted = 1;
+  thedl.distance = FLT_MAX;
+  thedl.tolerance = tolerance;
+  if (rt_dist3d_aabb_tree(ctx, t1, t2, &thedl))
+  {
+    return thedl.distance;
+  }
+  /*should never get here. all cases ought to be error handled earlier*/
+  rterror(ctx, "Some unspecified error.");
+  return FLT_MAX;
+}
+
+double
+rtgeom_aabb_tree_mindistance3d(const RTCTX *ctx, const RTAABBTREE *t1, const RTAABBTREE *t2)
+{
+  return rtgeom_aabb_tree_mindistance3d_tolerance(ctx, t1, t2, 0.0);
+}
+
+/**
+  Function telling whether two indexed geometries are within the
+  given 3d distance of each other.
+*/
+int
+rtgeom_aabb_tree_dwithin3d(const RTCTX *ctx, const RTAABBTREE *t1, const RTAABBTREE *t2, double tolerance)
+{
+  DISTPTS3D thedl;
+
+  if ( tolerance < 0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero");
+    return RT_FALSE;
+  }
+
+  if(!rtgeom_has_z(ctx, t1->geom) || !rtgeom_has_z(ctx, t2->geom))
+  {
+    rtnotice(ctx, "One or both of the geometries is missing z-value. The unknown z-value will be regarded as \"any value\"");
+    return rtgeom_dwithin2d(ctx, t1->geom, t2->geom, tolerance);
+  }
+  RTDEBUG(ctx, 2, "rtgeom_aabb_tree_dwithin3d is called");
+
+  if ( rtgeom_is_empty(ctx, t1->geom) || rtgeom_is_empty(ctx, t2->geom) )
+    return RT_FALSE;
+
+  thedl.mode = DIST_MIN;
+  thedl.twisted = 1;
+  /* Nothing farther than the tolerance matters, let it be pruned */
+  thedl.distance = tolerance + FP_TOLERANCE;
+  thedl.tolerance = tolerance;
+
+  if ( ! rt_dist3d_aabb_tree_usable(ctx, t1) || ! rt_dist3d_aabb_tree_usable(ctx, t2) )
+  {
+    if ( ! rt_dist3d_dwithin_recursive(ctx, t1->geom, t2->geom, &thedl) )
+      return RT_FALSE;
+  }
+  else if ( ! rt_dist3d_aabb_tree(ctx, t1, t2, &thedl) )
+  {
+    return RT_FALSE;
+  }
+  return thedl.distance <= tolerance;
+}
+
 
 /*------------------------------------------------------------------------------------------------------------
 End of Initializing functions
@@ -475,6 +670,70 @@ int rt_dist3d_recursive(const RTCTX *ctx, const RTGEOM *rtg1,const RTGEOM *rtg2,
 
 
 
+/**
+Whether the 3d boxes of two geometries are farther apart than dl->distance
+along any axis, so that they have nothing closer to offer.
+*/
+static int
+rt_dist3d_gbox_far(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl)
+{
+  RTGBOX b1, b2;
+  double d = dl->distance;
+
+  if ( rtgeom_get_bbox_cartesian(ctx, rtg1, &b1) != RT_SUCCESS ||
+       rtgeom_get_bbox_cartesian(ctx, rtg2, &b2) != RT_SUCCESS )
+    return RT_FALSE;
+
+  return b1.xmin - d > b2.xmax || b2.xmin - d > b1.xmax ||
+         b1.ymin - d > b2.ymax || b2.ymin - d > b1.ymax ||
+         b1.zmin - d > b2.zmax || b2.zmin - d > b1.zmax;
+}
+
+/**
+Like rt_dist3d_recursive, but only looking for a distance within
+dl->tolerance: pairs of components with far apart boxes are skipped
+and the search stops as soon as a close enough pair is found.
+*/
+int rt_dist3d_dwithin_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl)
+{
+  int i;
+
+  if (rtgeom_is_collection(ctx, rtg1))
+  {
+    const RTCOLLECTION *c1 = (const RTCOLLECTION*)rtg1;
+    for ( i = 0; i < c1->ngeoms; i++ )
+    {
+      if (!rt_dist3d_dwithin_recursive(ctx, c1->geoms[i], rtg2, dl)) return RT_FALSE;
+      if (dl->distance<=dl->tolerance) return RT_TRUE;
+    }
+    return RT_TRUE;
+  }
+
+  if (rtgeom_is_collection(ctx, rtg2))
+  {
+    const RTCOLLECTION *c2 = (const RTCOLLECTION*)rtg2;
+    for ( i = 0; i < c2->ngeoms; i++ )
+    {
+      if (!rt_dist3d_dwithin_recursive(ctx, rtg1, c2->geoms[i], dl)) return RT_FALSE;
+      if (dl->distance<=dl->tolerance) return RT_TRUE;
+    }
+    return RT_TRUE;
+  }
+
+  /*True here only means continue searching*/
+  if (rtgeom_is_empty(ctx, rtg1)||rtgeom_is_empty(ctx, rtg2)) return RT_TRUE;
+
+  if (rt_dist3d_gbox_far(ctx, rtg1, rtg2, dl))
+  {
+    RTDEBUG(ctx, 3, "boxes too far apart, skipping");
+    return RT_TRUE;
+  }
+
+  return rt_dist3d_distribute_bruteforce(ctx, rtg1, rtg2, dl);
+}
+
+
+
 /**
 
 This function distributes the brute-force for 3D so far the only type, tasks depending on type
@@ -574,9 +833,252 @@ End of Preprocessing functions
 --------------------------------------------------------------------------------------------------------------*/
 
 
+/*------------------------------------------------------------------------------------------------------------
+Indexed distance calculations
+Branch and bound search between the aabb trees of two geometries
+--------------------------------------------------------------------------------------------------------------*/
+
+/**
+  Order the children to visit next for a pair of nodes, splitting
+  the internal node with the biggest box, closest child first.
+*/
+static void
+rt_dist3d_aabb_split(const RTCTX *ctx, const AABB_NODE *n1, const AABB_NODE *n2,
+                     const AABB_NODE **a1, const AABB_NODE **a2, const AABB_NODE **b1, const AABB_NODE **b2)
+{
+  double s1 = (n1->max[0] - n1->min[0]) + (n1->max[1] - n1->min[1]) + (n1->max[2] - n1->min[2]);
+  double s2 = (n2->max[0] - n2->min[0]) + (n2->max[1] - n2->min[1]) + (n2->max[2] - n2->min[2]);
+
+  if ( ! n2->left_node || ( n1->left_node && s1 >= s2 ) )
+  {
+    *a1 = n1->left_node;
+    *b1 = n1->right_node;
+    *a2 = *b2 = n2;
+    if ( aabb_node_distance(ctx, n1->right_node, n2) < aabb_node_distance(ctx, n1->left_node, n2) )
+    {
+      *a1 = n1->right_node;
+      *b1 = n1->left_node;
+    }
+  }
+  else
+  {
+    *a1 = *b1 = n1;
+    *a2 = n2->left_node;
+    *b2 = n2->right_node;
+    if ( aabb_node_distance(ctx, n1, n2->right_node) < aabb_node_distance(ctx, n1, n2->left_node) )
+    {
+      *a2 = n2->right_node;
+      *b2 = n2->left_node;
+    }
+  }
+}
+
+/**
+  Recursive descent of the edge trees of two point arrays, pruning
+  node pairs whose boxes are farther apart than the distance found
+  so far. Same result as rt_dist3d_ptarray_ptarray for mindistance.
+*/
+static int
+rt_dist3d_aabb_edges(const RTCTX *ctx, const AABB_NODE *n1, const RTPOINTARRAY *pa1,
+                     const AABB_NODE *n2, const RTPOINTARRAY *pa2, int twist, DISTPTS3D *dl)
+{
+  const AABB_NODE *a1, *a2, *b1, *b2;
+
+  if ( aabb_node_distance(ctx, n1, n2) > dl->distance )
+    return RT_TRUE;
+
+  /* Two edges (or points), compute the actual distance */
+  if ( ! n1->left_node && ! n2->left_node )
+  {
+    RTPOINT3DZ start, end, start2, end2;
+
+    rt_getPoint3dz_p(ctx, pa1, n1->index, &start);
+    end = start;
+    if ( n1->index + 1 < pa1->npoints )
+      rt_getPoint3dz_p(ctx, pa1, n1->index + 1, &end);
+    rt_getPoint3dz_p(ctx, pa2, n2->index, &start2);
+    end2 = start2;
+    if ( n2->index + 1 < pa2->npoints )
+      rt_getPoint3dz_p(ctx, pa2, n2->index + 1, &end2);
+
+    dl->twisted = twist;
+    return rt_dist3d_seg_seg(ctx, &start, &end, &start2, &end2, dl);
+  }
+
+  rt_dist3d_aabb_split(ctx, n1, n2, &a1, &a2, &b1, &b2);
+
+  if ( ! rt_dist3d_aabb_edges(ctx, a1, pa1, a2, pa2, twist, dl) )
+    return RT_FALSE;
+
+  /* just a check if the answer is already given */
+  if ( dl->distance <= dl->tolerance )
+    return RT_TRUE;
+
+  return rt_dist3d_aabb_edges(ctx, b1, pa1, b2, pa2, twist, dl);
+}
+
+/**
+  Compare the projection of a vertex on the plane of a polygon to
+  the vertex, if it lies in the polygon. Vertices farther from the
+  plane than the distance found so far are not worth a test.
+*/
+static void
+rt_dist3d_aabb_pt_plane(const RTCTX *ctx, RTPOINT3DZ *p, RTPOINT3DZ *projp, double f, const AABB_COMP *poly, int twist, DISTPTS3D *dl)
+{
+  if ( fabs(f) * poly->pvlength >= dl->distance )
+    return;
+
+  if ( aabb_comp_contains_point(ctx, poly, projp) )
+  {
+    dl->twisted = twist;
+    rt_dist3d_pt_pt(ctx, p, projp, dl);
+  }
+}
+
+/**
+  Indexed counterpart of rt_dist3d_ptarray_poly, using the cached
+  plane and the ring trees of the polygon.
+  Vertex to ring distances are left to the edge pairs, which
+  cover them.
+*/
+static int
+rt_dist3d_aabb_ptarray_poly(const RTCTX *ctx, RTPOINTARRAY *pa, const AABB_NODE *tree, const AABB_COMP *poly, int twist, DISTPTS3D *dl)
+{
+  int i, j;
+  double f, s1, s2;
+  VECTOR3D projp1_projp2;
+  RTPOINT3DZ p1, p2, projp1, projp2, intersectionp;
+  PLANE3D plane = poly->plane;
+
+  rt_getPoint3dz_p(ctx, pa, 0, &p1);
+  s1 = project_point_on_plane(ctx, &p1, &plane, &projp1);
+  rt_dist3d_aabb_pt_plane(ctx, &p1, &projp1, s1, poly, twist, dl);
+
+  for ( i = 1; i < pa->npoints; i++ )
+  {
+    rt_getPoint3dz_p(ctx, pa, i, &p2);
+    s2 = project_point_on_plane(ctx, &p2, &plane, &projp2);
+    rt_dist3d_aabb_pt_plane(ctx, &p2, &projp2, s2, poly, twist, dl);
+
+    /* The edge crosses the plane of the polygon, does it cross the polygon? */
+    if ( (s1*s2) <= 0 )
+    {
+      f = fabs(s1) / (fabs(s1) + fabs(s2));
+      get_3dvector_from_points(ctx, &projp1, &projp2, &projp1_projp2);
+
+      intersectionp.x = projp1.x + f * projp1_projp2.x;
+      intersectionp.y = projp1.y + f * projp1_projp2.y;
+      intersectionp.z = projp1.z + f * projp1_projp2.z;
+
+      if ( aabb_comp_contains_point(ctx, poly, &intersectionp) )
+      {
+        dl->distance = 0.0;
+        dl->p1 = intersectionp;
+        dl->p2 = intersectionp;
+        return RT_TRUE;
+      }
+    }
+
+    projp1 = projp2;
+    s1 = s2;
+  }
+
+  /* check or pointarray against boundary and inner boundaries of the polygon */
+  for ( j = 0; j < poly->nrings; j++ )
+  {
+    if ( ! poly->trees[j] )
+      continue;
+    if ( ! rt_dist3d_aabb_edges(ctx, tree, pa, poly->trees[j], poly->rings[j], twist, dl) )
+      return RT_FALSE;
+    if ( dl->distance <= dl->tolerance )
+      return RT_TRUE;
+  }
+
+  return RT_TRUE;
+}
+
+/**
+  Min distance between two indexed components, dispatched like
+  rt_dist3d_distribute_bruteforce does.
+*/
+static int
+rt_dist3d_aabb_comp_comp(const RTCTX *ctx, const AABB_COMP *c1, const AABB_COMP *c2, DISTPTS3D *dl)
+{
+  if ( c1->type == RTPOLYGONTYPE && c2->type == RTPOLYGONTYPE )
+  {
+    /* Boundary of each polygon against the other polygon */
+    if ( ! rt_dist3d_aabb_ptarray_poly(ctx, c1->rings[0], c1->trees[0], c2, 1, dl) )
+      return RT_FALSE;
+    if ( dl->distance <= dl->tolerance || dl->distance == 0.0 )
+      return RT_TRUE;
+    return rt_dist3d_aabb_ptarray_poly(ctx, c2->rings[0], c2->trees[0], c1, -1, dl);
+  }
+  if ( c2->type == RTPOLYGONTYPE )
+    return rt_dist3d_aabb_ptarray_poly(ctx, c1->rings[0], c1->trees[0], c2, 1, dl);
+  if ( c1->type == RTPOLYGONTYPE )
+    return rt_dist3d_aabb_ptarray_poly(ctx, c2->rings[0], c2->trees[0], c1, -1, dl);
+
+  return rt_dist3d_aabb_edges(ctx, c1->trees[0], c1->rings[0], c2->trees[0], c2->rings[0], 1, dl);
+}
+
+/**
+  Recursive descent of the component trees of two geometries,
+  measuring only the pairs of components whose boxes are not
+  farther apart than the distance found so far.
+*/
+static int
+rt_dist3d_aabb_comps(const RTCTX *ctx, const RTAABBTREE *t1, const AABB_NODE *n1,
+                     const RTAABBTREE *t2, const AABB_NODE *n2, DISTPTS3D *dl)
+{
+  const AABB_NODE *a1, *a2, *b1, *b2;
+
+  if ( aabb_node_distance(ctx, n1, n2) > dl->distance )
+    return RT_TRUE;
+
+  if ( ! n1->left_node && ! n2->left_node )
+    return rt_dist3d_aabb_comp_comp(ctx, &(t1->comps[n1->index]), &(t2->comps[n2->index]), dl);
+
+  rt_dist3d_aabb_split(ctx, n1, n2, &a1, &a2, &b1, &b2);
+
+  if ( ! rt_dist3d_aabb_comps(ctx, t1, a1, t2, a2, dl) )
+    return RT_FALSE;
+
+  /* just a check if the answer is already given */
+  if ( dl->distance <= dl->tolerance )
+    return RT_TRUE;
+
+  return rt_dist3d_aabb_comps(ctx, t1, b1, t2, b2, dl);
+}
+
+/**
+  Min distance between two indexed geometries, the same as
+  rt_dist3d_recursive would find.
+*/
+int
+rt_dist3d_aabb_tree(const RTCTX *ctx, const RTAABBTREE *t1, const RTAABBTREE *t2, DISTPTS3D *dl)
+{
+  RTDEBUG(ctx, 2, "rt_dist3d_aabb_tree is called");
+
+  if ( dl->mode != DIST_MIN )
+  {
+    rterror(ctx, "rt_dist3d_aabb_tree: only min distances are supported");
+    return RT_FALSE;
+  }
+
+  /* Empty geometries, nothing to measure */
+  if ( ! t1->tree || ! t2->tree )
+    return RT_TRUE;
+
+  return rt_dist3d_aabb_comps(ctx, t1, t1->tree, t2, t2->tree, dl);
+}
+
+/*------------------------------------------------------------------------------------------------------------
+End of Indexed distance calculations
+--------------------------------------------------------------------------------------------------------------*/
+
+
 /*------------------------------------------------------------------------------------------------------------
 Brute force functions
-So far the only way to do 3D-calculations
 --------------------------------------------------------------------------------------------------------------*/
 
 /**
@@ -1365,4 +1867,248 @@ End of Brute force functions
 --------------------------------------------------------------------------------------------------------------*/
 
 
+/*------------------------------------------------------------------------------------------------------------
+Batch plane functions
+Projection and point in polygon tests of many points against the cached plane of a polygon,
+on contiguous coordinate arrays so the compiler can vectorize the inner loops
+--------------------------------------------------------------------------------------------------------------*/
+
+/**
+* Number of points projected and tested together
+*/
+#define POLY_PLANE_BLOCK 256
+
+RTPOLYPLANE *
+rtpoly_plane_create(const RTCTX *ctx, const RTPOLY *poly)
+{
+  RTPOLYPLANE *pp;
+  RTPOINT3DZ p;
+  double ax, ay, az;
+  int i, j, k, nvertices = 0;
+
+  if ( rtpoly_is_empty(ctx, poly) )
+  {
+    rterror(ctx, "rtpoly_plane_create: empty polygon");
+    return NULL;
+  }
+  /* define_plane needs at least a triangle */
+  if ( poly->rings[0]->npoints < 4 )
+  {
+    rterror(ctx, "rtpoly_plane_create: shell has less than four points");
+    return NULL;
+  }
+  for ( i = 0; i < poly->nrings; i++ )
+  {
+    if ( poly->rings[i]->npoints > 0 && ! ptarray_is_closed_3d(ctx, poly->rings[i]) )
+    {
+      rterror(ctx, "rtpoly_plane_create: ring %d is not closed", i);
+      return NULL;
+    }
+    nvertices += poly->rings[i]->npoints;
+  }
+
+  pp = rtalloc(ctx, sizeof(RTPOLYPLANE));
+  define_plane(ctx, poly->rings[0], &(pp->plane));
+  pp->pvpv = DOT(pp->plane.pv, pp->plane.pv);
+
+  /* Same choice of coordinate plane as pt_in_ring_3d */
+  ax = fabs(pp->plane.pv.x);
+  ay = fabs(pp->plane.pv.y);
+  az = fabs(pp->plane.pv.z);
+  if ( az >= ax && az >= ay )
+  {
+    pp->u = 0;
+    pp->v = 1;
+  }
+  else if ( ay >= ax && ay >= az )
+  {
+    pp->u = 0;
+    pp->v = 2;
+  }
+  else
+  {
+    pp->u = 1;
+    pp->v = 2;
+  }
+
+  pp->nrings = poly->nrings;
+  pp->offsets = rtalloc(ctx, sizeof(int) * (poly->nrings + 1));
+  pp->ru = rtalloc(ctx, sizeof(double) * (nvertices ? nvertices : 1));
+  pp->rv = rtalloc(ctx, sizeof(double) * (nvertices ? nvertices : 1));
+  for ( i = 0, k = 0; i < poly->nrings; i++ )
+  {
+    pp->offsets[i] = k;
+    for ( j = 0; j < poly->rings[i]->npoints; j++, k++ )
+    {
+      rt_getPoint3dz_p(ctx, poly->rings[i], j, &p);
+      pp->ru[k] = pp->u == 0 ? p.x : p.y;
+      pp->rv[k] = pp->v == 1 ? p.y : p.z;
+    }
+  }
+  pp->offsets[poly->nrings] = k;
+
+  return pp;
+}
+
+void
+rtpoly_plane_destroy(const RTCTX *ctx, RTPOLYPLANE *pp)
+{
+  rtfree(ctx, pp->offsets);
+  rtfree(ctx, pp->ru);
+  rtfree(ctx, pp->rv);
+  rtfree(ctx, pp);
+}
+
+/**
+* Project n points, given by their coordinates, on a plane,
+* the way project_point_on_plane does, storing the projections in
+* place and the factors of plane->pv moving each point there in f.
+*/
+void
+project_points_on_plane(const PLANE3D *pl, double pvpv, int n, double *x, double *y, double *z, double *f)
+{
+  double popx = pl->pop.x, popy = pl->pop.y, popz = pl->pop.z;
+  double pvx = pl->pv.x, pvy = pl->pv.y, pvz = pl->pv.z;
+  int i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    double fi = -((pvx * (x[i] - popx) + pvy * (y[i] - popy) + pvz * (z[i] - popz)) / pvpv);
+    x[i] += pvx * fi;
+    y[i] += pvy * fi;
+    z[i] += pvz * fi;
+    f[i] = fi;
+  }
+}
+
+/**
+* Crossing number test of n points against a ring, both projected
+* on a coordinate plane, with the rules of pt_in_ring_3d: the ray
+* is cast from each point along axis u. The ring is given by its
+* vertices, first and last the same. Toggles cn[i] for each edge
+* point i crosses, so that it ends odd when inside.
+*
+* Edges are the outer loop and the test is free of branches, for
+* the points to be handled by vector instructions.
+*/
+void
+pt_in_ring_3d_batch(const double *ru, const double *rv, int nvertices, int n, const double *pu, const double *pv, int *cn)
+{
+  int e, i;
+
+  for ( e = 0; e + 1 < nvertices; e++ )
+  {
+    double u1 = ru[e], v1 = rv[e], u2 = ru[e+1], v2 = rv[e+1];
+    double du = u2 - u1, dv = v2 - v1;
+
+    /* Horizontal edges are never crossed */
+    if ( dv == 0 )
+      continue;
+
+    for ( i = 0; i < n; i++ )
+    {
+      int crosses = ( v1 <= pv[i] ) != ( v2 <= pv[i] );
+      double vt = (pv[i] - v1) / dv;
+      cn[i] ^= crosses & ( pu[i] < u1 + vt * du );
+    }
+  }
+}
+
+/**
+* Project a block of points on the plane of the polygon, leaving the
+* coordinates of the projections in x, y and z.
+*/
+static void
+rtpoly_plane_project_block(const RTCTX *ctx, const RTPOLYPLANE *pp, const RTPOINTARRAY *pa, int start, int n,
+                           double *x, double *y, double *z, double *f)
+{
+  RTPOINT3DZ p;
+  int i;
+
+  for ( i = 0; i < n; i++ )
+  {
+    rt_getPoint3dz_p(ctx, pa, start + i, &p);
+    x[i] = p.x;
+    y[i] = p.y;
+    z[i] = p.z;
+  }
+  project_points_on_plane(&(pp->plane), pp->pvpv, n, x, y, z, f);
+}
+
+RTPOINTARRAY *
+rtpoly_plane_project_points(const RTCTX *ctx, const RTPOLYPLANE *pp, const RTPOINTARRAY *pa, double *distances)
+{
+  double x[POLY_PLANE_BLOCK], y[POLY_PLANE_BLOCK], z[POLY_PLANE_BLOCK], f[POLY_PLANE_BLOCK];
+  double pvlength = sqrt(pp->pvpv);
+  RTPOINTARRAY *out = ptarray_construct(ctx, 1, 0, pa->npoints);
+  RTPOINT3DZ *q;
+  int start, n, i;
+
+  for ( start = 0; start < pa->npoints; start += n )
+  {
+    n = FP_MIN(POLY_PLANE_BLOCK, pa->npoints - start);
+    rtpoly_plane_project_block(ctx, pp, pa, start, n, x, y, z, f);
+    for ( i = 0; i < n; i++ )
+    {
+      q = (RTPOINT3DZ*)rt_getPoint_internal(ctx, out, start + i);
+      q->x = x[i];
+      q->y = y[i];
+      q->z = z[i];
+      if ( distances )
+        distances[start + i] = -f[i] * pvlength;
+    }
+  }
+
+  return out;
+}
+
+int
+rtpoly_plane_contains_points(const RTCTX *ctx, const RTPOLYPLANE *pp, const RTPOINTARRAY *pa, int *inside)
+{
+  double x[POLY_PLANE_BLOCK], y[POLY_PLANE_BLOCK], z[POLY_PLANE_BLOCK], f[POLY_PLANE_BLOCK];
+  double *coords[3];
+  int cn[POLY_PLANE_BLOCK], in_hole[POLY_PLANE_BLOCK];
+  int start, n, i, r, count = 0;
+
+  coords[0] = x;
+  coords[1] = y;
+  coords[2] = z;
+
+  for ( start = 0; start < pa->npoints; start += n )
+  {
+    n = FP_MIN(POLY_PLANE_BLOCK, pa->npoints - start);
+    rtpoly_plane_project_block(ctx, pp, pa, start, n, x, y, z, f);
+
+    memset(cn, 0, sizeof(int) * n);
+    pt_in_ring_3d_batch(pp->ru, pp->rv, pp->offsets[1], n, coords[pp->u], coords[pp->v], cn);
+
+    /* Inside the shell, is it in a hole? */
+    memset(in_hole, 0, sizeof(int) * n);
+    for ( r = 1; r < pp->nrings; r++ )
+    {
+      int h[POLY_PLANE_BLOCK];
+      int o = pp->offsets[r];
+
+      memset(h, 0, sizeof(int) * n);
+      pt_in_ring_3d_batch(pp->ru + o, pp->rv + o, pp->offsets[r+1] - o, n, coords[pp->u], coords[pp->v], h);
+      for ( i = 0; i < n; i++ )
+        in_hole[i] |= h[i];
+    }
+
+    for ( i = 0; i < n; i++ )
+    {
+      inside[start + i] = cn[i] & ! in_hole[i];
+      count += inside[start + i];
+    }
+  }
+
+  return count;
+}
+
+/*------------------------------------------------------------------------------------------------------------
+End of Batch plane functions
+--------------------------------------------------------------------------------------------------------------*/
+
+
+
 
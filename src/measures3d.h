@@ -72,8 +72,14 @@ Preprocessing functions
 */
 int rt_dist3d_distribute_bruteforce(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl);
 int rt_dist3d_recursive(const RTCTX *ctx, const RTGEOM *rtg1,const RTGEOM *rtg2, DISTPTS3D *dl);
+int rt_dist3d_dwithin_recursive(const RTCTX *ctx, const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl);
 int rt_dist3d_distribute_fast(const RTGEOM *rtg1, const RTGEOM *rtg2, DISTPTS3D *dl);
 
+/*
+Indexed functions
+*/
+int rt_dist3d_aabb_tree(const RTCTX *ctx, const RTAABBTREE *t1, const RTAABBTREE *t2, DISTPTS3D *dl);
+
 /*
 Brute force functions
 */
@@ -97,6 +103,28 @@ double project_point_on_plane(const RTCTX *ctx, RTPOINT3DZ *p,  PLANE3D *pl, RTP
 int define_plane(const RTCTX *ctx, RTPOINTARRAY *pa, PLANE3D *pl);
 int pt_in_ring_3d(const RTCTX *ctx, const RTPOINT3DZ *p, const RTPOINTARRAY *ring,PLANE3D *plane);
 
+/*
+Batch plane functions
+*/
+
+/**
+* The plane of a polygon, computed once, along with its rings
+* projected on the coordinate plane it faces most (axes u and v),
+* stored as contiguous coordinate arrays.
+*/
+struct RTPOLYPLANE
+{
+  PLANE3D plane;
+  double pvpv;      /* squared length of plane.pv */
+  int u, v;         /* axes rings are tested on, as pt_in_ring_3d picks them */
+  int nrings;
+  int *offsets;     /* first vertex of each ring in ru and rv, then their total */
+  double *ru, *rv;  /* ring vertices, shell first */
+};
+
+void project_points_on_plane(const PLANE3D *pl, double pvpv, int n, double *x, double *y, double *z, double *f);
+void pt_in_ring_3d_batch(const double *ru, const double *rv, int nvertices, int n, const double *pu, const double *pv, int *cn);
+
 /*
 Helper functions
 */
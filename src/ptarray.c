@@ -33,6 +33,28 @@
 #include "librttopo_geom_internal.h"
 #include "rtgeom_log.h"
 
+/*
+ * Dimension specialized kernels
+ *
+ * Hot loops read the ordinates straight from the serialized point
+ * list instead of going through rt_getPoint4d_p. A kernel macro
+ * taking the point stride and the HASZ/HASM flags as constants is
+ * instantiated once per layout by PTARRAY_SPECIALIZE, so that the
+ * compiler drops the code of missing ordinates, and the instance
+ * matching the flags of an array is picked once per call by
+ * PTARRAY_DISPATCH. Z is at offset 2, M right after the present ones.
+ */
+#define PTARRAY_SPECIALIZE(KERNEL, name) \
+  KERNEL(name##_2d, 2, 0, 0) \
+  KERNEL(name##_3dz, 3, 1, 0) \
+  KERNEL(name##_3dm, 3, 0, 1) \
+  KERNEL(name##_4d, 4, 1, 1)
+
+#define PTARRAY_DISPATCH(flags, name, args) \
+  ( RTFLAGS_GET_Z(flags) ? \
+    ( RTFLAGS_GET_M(flags) ? name##_4d args : name##_3dz args ) : \
+    ( RTFLAGS_GET_M(flags) ? name##_3dm args : name##_2d args ) )
+
 int
 ptarray_has_z(const RTCTX *ctx, const RTPOINTARRAY *pa)
 {
@@ -72,6 +94,8 @@ ptarray_construct_empty(const RTCTX *ctx, char hasz, char hasm, uint32_t maxpoin
 {
   RTPOINTARRAY *pa = rtalloc(ctx, sizeof(RTPOINTARRAY));
   pa->serialized_pointlist = NULL;
+  pa->geocentric = NULL;
+  pa->soa = NULL;
 
   /* Set our dimsionality info on the bitmap */
   pa->flags = gflags(ctx, hasz, hasm, 0);
@@ -89,6 +113,50 @@ ptarray_construct_empty(const RTCTX *ctx, char hasz, char hasm, uint32_t maxpoin
   return pa;
 }
 
+/**
+* Make room for at least npoints points, at least doubling the
+* storage when growing so that repeated appends are amortized.
+*/
+static void
+ptarray_grow(const RTCTX *ctx, RTPOINTARRAY *pa, uint32_t npoints)
+{
+  size_t ptsize = ptarray_point_size(ctx, pa);
+  uint32_t maxpoints;
+
+  if ( pa->serialized_pointlist && pa->maxpoints >= npoints )
+    return;
+
+  if ( ! pa->serialized_pointlist )
+    pa->maxpoints = 0;
+  maxpoints = pa->maxpoints ? pa->maxpoints * 2 : 32;
+  if ( maxpoints < npoints )
+    maxpoints = npoints;
+
+  if ( pa->serialized_pointlist )
+    pa->serialized_pointlist = rtrealloc(ctx, pa->serialized_pointlist, ptsize * maxpoints);
+  else
+    pa->serialized_pointlist = rtalloc(ctx, ptsize * maxpoints);
+  pa->maxpoints = maxpoints;
+}
+
+int
+ptarray_reserve(const RTCTX *ctx, RTPOINTARRAY *pa, uint32_t npoints)
+{
+  size_t ptsize = ptarray_point_size(ctx, pa);
+
+  ptarray_make_writable(ctx, pa);
+
+  if ( pa->serialized_pointlist && pa->maxpoints >= npoints )
+    return RT_SUCCESS;
+
+  if ( pa->serialized_pointlist )
+    pa->serialized_pointlist = rtrealloc(ctx, pa->serialized_pointlist, ptsize * npoints);
+  else
+    pa->serialized_pointlist = rtalloc(ctx, ptsize * npoints);
+  pa->maxpoints = npoints;
+  return RT_SUCCESS;
+}
+
 /*
 * Add a point into a pointarray. Only adds as many dimensions as the
 * pointarray supports.
@@ -100,11 +168,8 @@ ptarray_insert_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *p, int
   RTDEBUGF(ctx, 5,"pa = %p; p = %p; where = %d", pa, p, where);
   RTDEBUGF(ctx, 5,"pa->npoints = %d; pa->maxpoints = %d", pa->npoints, pa->maxpoints);
 
-  if ( RTFLAGS_GET_READONLY(pa->flags) )
-  {
-    rterror(ctx, "ptarray_insert_point: called on read-only point array");
-    return RT_FAILURE;
-  }
+  ptarray_make_writable(ctx, pa);
+  ptarray_caches_clear(ctx, pa);
 
   /* Error on invalid offset value */
   if ( where > pa->npoints || where < 0)
@@ -114,12 +179,8 @@ ptarray_insert_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *p, int
   }
 
   /* If we have no storage, let's allocate some */
-  if( pa->maxpoints == 0 || ! pa->serialized_pointlist )
-  {
-    pa->maxpoints = 32;
+  if( ! pa->serialized_pointlist )
     pa->npoints = 0;
-    pa->serialized_pointlist = rtalloc(ctx, ptarray_point_size(ctx, pa) * pa->maxpoints);
-  }
 
   /* Error out if we have a bad situation */
   if ( pa->npoints > pa->maxpoints )
@@ -129,11 +190,7 @@ ptarray_insert_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *p, int
   }
 
   /* Check if we have enough storage, add more if necessary */
-  if( pa->npoints == pa->maxpoints )
-  {
-    pa->maxpoints *= 2;
-    pa->serialized_pointlist = rtrealloc(ctx, pa->serialized_pointlist, ptarray_point_size(ctx, pa) * pa->maxpoints);
-  }
+  ptarray_grow(ctx, pa, pa->npoints + 1);
 
   /* Make space to insert the new point */
   if( where < pa->npoints )
@@ -167,21 +224,104 @@ ptarray_append_point(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINT4D *pt, in
   /* Check for duplicate end point */
   if ( repeated_points == RT_FALSE && pa->npoints > 0 )
   {
-    RTPOINT4D tmp;
-    rt_getPoint4d_p(ctx, pa, pa->npoints-1, &tmp);
-    RTDEBUGF(ctx, 4,"checking for duplicate end point (pt = POINT(%g %g) pa->npoints-q = POINT(%g %g))",pt->x,pt->y,tmp.x,tmp.y);
+    const double *tmp = (const double *)rt_getPoint_internal(ctx, pa, pa->npoints-1);
+    int ndims = RTFLAGS_NDIMS(pa->flags);
+    RTDEBUGF(ctx, 4,"checking for duplicate end point (pt = POINT(%g %g) pa->npoints-q = POINT(%g %g))",pt->x,pt->y,tmp[0],tmp[1]);
 
     /* Return RT_SUCCESS and do nothing else if previous point in list is equal to this one */
-    if ( (pt->x == tmp.x) && (pt->y == tmp.y) &&
-         (RTFLAGS_GET_Z(pa->flags) ? pt->z == tmp.z : 1) &&
-         (RTFLAGS_GET_M(pa->flags) ? pt->m == tmp.m : 1) )
+    if ( (pt->x == tmp[0]) && (pt->y == tmp[1]) &&
+         (RTFLAGS_GET_Z(pa->flags) ? pt->z == tmp[2] : 1) &&
+         (RTFLAGS_GET_M(pa->flags) ? pt->m == tmp[ndims-1] : 1) )
     {
       return RT_SUCCESS;
     }
   }
 
-  /* Append is just a special case of insert */
-  return ptarray_insert_point(ctx, pa, pt, pa->npoints);
+  /* Append is insert at the end, without its shifting */
+  ptarray_make_writable(ctx, pa);
+  if( ! pa->serialized_pointlist )
+    pa->npoints = 0;
+  ptarray_grow(ctx, pa, pa->npoints + 1);
+  ++pa->npoints;
+  ptarray_set_point4d(ctx, pa, pa->npoints - 1, pt);
+
+  return RT_SUCCESS;
+}
+
+/**
+* Do two points of ndims ordinates have equal ordinates?
+*/
+static inline int
+ptarray_point_same(const double *p1, const double *p2, int ndims)
+{
+  int i;
+  for ( i = 0; i < ndims; i++ )
+    if ( p1[i] != p2[i] ) return RT_FALSE;
+  return RT_TRUE;
+}
+
+int
+ptarray_append_points(const RTCTX *ctx, RTPOINTARRAY *pa, const uint8_t *ptlist, uint32_t npoints, int repeated_points)
+{
+  int ndims;
+  size_t ptsize;
+  const double *in = (const double *)ptlist;
+  const double *prev;
+  uint8_t *out;
+  uint32_t i, run;
+
+  /* Check for pathology */
+  if( ! pa || ( npoints && ! ptlist ) )
+  {
+    rterror(ctx, "ptarray_append_points: null input");
+    return RT_FAILURE;
+  }
+
+  if ( ! npoints ) return RT_SUCCESS; /* nothing more to do */
+
+  ptarray_make_writable(ctx, pa);
+  ptarray_caches_clear(ctx, pa);
+  if( ! pa->serialized_pointlist )
+    pa->npoints = 0;
+  ptarray_grow(ctx, pa, pa->npoints + npoints);
+
+  ndims = RTFLAGS_NDIMS(pa->flags);
+  ptsize = ptarray_point_size(ctx, pa);
+  out = rt_getPoint_internal(ctx, pa, pa->npoints);
+
+  if ( repeated_points )
+  {
+    memcpy(out, ptlist, ptsize * npoints);
+    pa->npoints += npoints;
+    return RT_SUCCESS;
+  }
+
+  /* Copy the runs of points differing from their predecessor */
+  prev = pa->npoints ? (const double *)rt_getPoint_internal(ctx, pa, pa->npoints-1) : NULL;
+  i = 0;
+  while ( i < npoints )
+  {
+    /* Skip the repetitions of the last point kept */
+    while ( i < npoints && prev && ptarray_point_same(prev, in + i * ndims, ndims) )
+      i++;
+
+    /* Gather the run of points up to the next repetition */
+    run = i;
+    if ( run < npoints )
+    {
+      for ( run++; run < npoints; run++ )
+        if ( ptarray_point_same(in + (run - 1) * ndims, in + run * ndims, ndims) )
+          break;
+    }
+
+    memcpy(out, in + i * ndims, ptsize * (run - i));
+    out += ptsize * (run - i);
+    pa->npoints += run - i;
+    prev = in + (run - 1) * ndims;
+    i = run;
+  }
+
+  return RT_SUCCESS;
 }
 
 int
@@ -203,11 +343,8 @@ ptarray_append_ptarray(const RTCTX *ctx, RTPOINTARRAY *pa1, RTPOINTARRAY *pa2, d
 
   if ( ! npoints ) return RT_SUCCESS; /* nothing more to do */
 
-  if( RTFLAGS_GET_READONLY(pa1->flags) )
-  {
-    rterror(ctx, "ptarray_append_ptarray: target pointarray is read-only");
-    return RT_FAILURE;
-  }
+  ptarray_make_writable(ctx, pa1);
+  ptarray_caches_clear(ctx, pa1);
 
   if( RTFLAGS_GET_ZM(pa1->flags) != RTFLAGS_GET_ZM(pa2->flags) )
   {
@@ -239,12 +376,7 @@ ptarray_append_ptarray(const RTCTX *ctx, RTPOINTARRAY *pa1, RTPOINTARRAY *pa2, d
 
   /* Check if we need extra space */
   ncap = pa1->npoints + npoints;
-  if ( pa1->maxpoints < ncap )
-  {
-    pa1->maxpoints = ncap > pa1->maxpoints*2 ?
-                     ncap : pa1->maxpoints*2;
-    pa1->serialized_pointlist = rtrealloc(ctx, pa1->serialized_pointlist, ptsize * pa1->maxpoints);
-  }
+  ptarray_grow(ctx, pa1, ncap);
 
   memcpy(rt_getPoint_internal(ctx, pa1, pa1->npoints),
          rt_getPoint_internal(ctx, pa2, poff), ptsize * npoints);
@@ -277,6 +409,9 @@ ptarray_remove_point(const RTCTX *ctx, RTPOINTARRAY *pa, int where)
     return RT_FAILURE;
   }
 
+  ptarray_make_writable(ctx, pa);
+  ptarray_caches_clear(ctx, pa);
+
   /* If the point is any but the last, we need to copy the data back one point */
   if( where < pa->npoints - 1 )
   {
@@ -302,6 +437,8 @@ RTPOINTARRAY* ptarray_construct_reference_data(const RTCTX *ctx, char hasz, char
   pa->npoints = npoints;
   pa->maxpoints = npoints;
   pa->serialized_pointlist = ptlist;
+  pa->geocentric = NULL;
+  pa->soa = NULL;
   return pa;
 }
 
@@ -314,6 +451,8 @@ ptarray_construct_copy_data(const RTCTX *ctx, char hasz, char hasm, uint32_t npo
   pa->flags = gflags(ctx, hasz, hasm, 0);
   pa->npoints = npoints;
   pa->maxpoints = npoints;
+  pa->geocentric = NULL;
+  pa->soa = NULL;
 
   if ( npoints > 0 )
   {
@@ -334,11 +473,130 @@ void ptarray_free(const RTCTX *ctx, RTPOINTARRAY *pa)
   {
     if(pa->serialized_pointlist && ( ! RTFLAGS_GET_READONLY(pa->flags) ) )
       rtfree(ctx, pa->serialized_pointlist);
+    ptarray_caches_clear(ctx, pa);
     rtfree(ctx, pa);
     RTDEBUG(ctx, 5,"Freeing a PointArray");
   }
 }
 
+void ptarray_geocentric_clear(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  if ( pa->geocentric )
+  {
+    rtfree(ctx, pa->geocentric);
+    pa->geocentric = NULL;
+  }
+}
+
+void ptarray_soa_clear(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  if ( pa->soa )
+  {
+    rtfree(ctx, pa->soa);
+    pa->soa = NULL;
+  }
+}
+
+void ptarray_caches_clear(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  ptarray_geocentric_clear(ctx, pa);
+  ptarray_soa_clear(ctx, pa);
+}
+
+int
+ptarray_make_writable(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  size_t size;
+  uint8_t *copy = NULL;
+
+  if ( ! RTFLAGS_GET_READONLY(pa->flags) )
+    return RT_SUCCESS;
+
+  /* Copy the referenced points, dropping any spare capacity */
+  size = ptarray_point_size(ctx, pa) * pa->npoints;
+  if ( size )
+  {
+    copy = rtalloc(ctx, size);
+    memcpy(copy, pa->serialized_pointlist, size);
+  }
+  pa->serialized_pointlist = copy;
+  pa->maxpoints = pa->npoints;
+  RTFLAGS_SET_READONLY(pa->flags, 0);
+  return RT_SUCCESS;
+}
+
+/* Alignment of the split coordinate arrays, in bytes */
+#define SOA_ALIGN 64
+
+const RTPOINTARRAY_SOA *
+ptarray_soa_build(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  RTPOINTARRAY *cached = (RTPOINTARRAY*)pa;
+  RTPOINTARRAY_SOA *soa;
+  int ndims = RTFLAGS_NDIMS(pa->flags);
+  int hasz = RTFLAGS_GET_Z(pa->flags);
+  int hasm = RTFLAGS_GET_M(pa->flags);
+  /* Each array is padded to a whole number of aligned blocks */
+  size_t stride = ((size_t)pa->npoints * sizeof(double) + SOA_ALIGN - 1) & ~(size_t)(SOA_ALIGN - 1);
+  const double *in;
+  uintptr_t base;
+  int i;
+
+  if ( pa->npoints < 1 )
+    return NULL;
+  soa = RT_ATOMIC_LOAD_PTR(&cached->soa);
+  if ( soa )
+    return soa;
+
+  /* Readers of shared geometries must not allocate on them */
+  if ( RTFLAGS_GET_SHARED(pa->flags) )
+    return NULL;
+
+  /* Arrays follow the header in the same allocation */
+  soa = rtalloc(ctx, sizeof(RTPOINTARRAY_SOA) + SOA_ALIGN + ndims * stride);
+  base = ((uintptr_t)(soa + 1) + SOA_ALIGN - 1) & ~(uintptr_t)(SOA_ALIGN - 1);
+  soa->x = (double *)base;
+  soa->y = (double *)(base + stride);
+  soa->z = hasz ? (double *)(base + 2 * stride) : NULL;
+  soa->m = hasm ? (double *)(base + (ndims - 1) * stride) : NULL;
+
+  in = (const double *)pa->serialized_pointlist;
+  for ( i = 0; i < pa->npoints; i++, in += ndims )
+  {
+    soa->x[i] = in[0];
+    soa->y[i] = in[1];
+    if ( hasz ) soa->z[i] = in[2];
+    if ( hasm ) soa->m[i] = in[ndims-1];
+  }
+
+  /* Published as the kernels load it, see RT_ATOMIC_PUBLISH */
+  if ( ! RT_ATOMIC_PUBLISH(&cached->soa, soa) )
+  {
+    rtfree(ctx, soa);
+    soa = RT_ATOMIC_LOAD_PTR(&cached->soa);
+  }
+  return soa;
+}
+
+RTPOINTARRAY*
+ptarray_construct_from_soa(const RTCTX *ctx, char hasz, char hasm, uint32_t npoints, const double *x, const double *y, const double *z, const double *m)
+{
+  RTPOINTARRAY *pa = ptarray_construct(ctx, hasz, hasm, npoints);
+  int ndims = RTFLAGS_NDIMS(pa->flags);
+  double *out = (double *)pa->serialized_pointlist;
+  uint32_t i;
+
+  for ( i = 0; i < npoints; i++, out += ndims )
+  {
+    out[0] = x[i];
+    out[1] = y[i];
+    if ( hasz ) out[2] = z[i];
+    if ( hasm ) out[ndims-1] = m[i];
+  }
+
+  return pa;
+}
+
 
 void
 ptarray_reverse(const RTCTX *ctx, RTPOINTARRAY *pa)
@@ -350,6 +608,9 @@ ptarray_reverse(const RTCTX *ctx, RTPOINTARRAY *pa)
   int last = pa->npoints-1;
   int mid = pa->npoints/2;
 
+  ptarray_make_writable(ctx, pa);
+  ptarray_caches_clear(ctx, pa);
+
   for (i=0; i<mid; i++)
   {
     uint8_t *from, *to;
@@ -424,14 +685,22 @@ ptarray_segmentize2d(const RTCTX *ctx, const RTPOINTARRAY *ipa, double dist)
   RTPOINT4D  p1, p2;
   RTPOINT4D pbuf;
   RTPOINTARRAY *opa;
+  double opoints;
   int ipoff=0; /* input point offset */
   int hasz = RTFLAGS_GET_Z(ipa->flags);
   int hasm = RTFLAGS_GET_M(ipa->flags);
 
   pbuf.x = pbuf.y = pbuf.z = pbuf.m = 0;
 
-  /* Initial storage */
-  opa = ptarray_construct_empty(ctx, hasz, hasm, ipa->npoints);
+  /* Initial storage, for all the points to be added */
+  opoints = 1;
+  for ( ipoff = 1; ipoff < ipa->npoints; ipoff++ )
+  {
+    segdist = distance2d_pt_pt(ctx, rt_getPoint2d_cp(ctx, ipa, ipoff-1), rt_getPoint2d_cp(ctx, ipa, ipoff));
+    opoints += segdist > dist ? ceil(segdist / dist) : 1;
+  }
+  ipoff = 0;
+  opa = ptarray_construct_empty(ctx, hasz, hasm, opoints < UINT32_MAX ? (uint32_t)opoints : ipa->npoints);
 
   /* Add first point */
   rt_getPoint4d_p(ctx, ipa, ipoff, &p1);
@@ -642,8 +911,11 @@ ptarray_clone_deep(const RTCTX *ctx, const RTPOINTARRAY *in)
   out->flags = in->flags;
   out->npoints = in->npoints;
   out->maxpoints = in->maxpoints;
+  out->geocentric = NULL;
+  out->soa = NULL;
 
   RTFLAGS_SET_READONLY(out->flags, 0);
+  RTFLAGS_SET_SHARED(out->flags, 0);
 
   size = in->npoints * ptarray_point_size(ctx, in);
   out->serialized_pointlist = rtalloc(ctx, size);
@@ -665,8 +937,11 @@ ptarray_clone(const RTCTX *ctx, const RTPOINTARRAY *in)
   out->flags = in->flags;
   out->npoints = in->npoints;
   out->maxpoints = in->maxpoints;
+  out->geocentric = NULL;
+  out->soa = NULL;
 
   RTFLAGS_SET_READONLY(out->flags, 1);
+  RTFLAGS_SET_SHARED(out->flags, 0);
 
   out->serialized_pointlist = in->serialized_pointlist;
 
@@ -724,6 +999,8 @@ ptarray_contains_point_partial(const RTCTX *ctx, const RTPOINTARRAY *pa, const R
   const RTPOINT2D *seg1;
   const RTPOINT2D *seg2;
   double ymin, ymax;
+  /* may be published concurrently, see ptarray_soa_build */
+  const RTPOINTARRAY_SOA *soa = RT_ATOMIC_LOAD_PTR(&pa->soa);
 
   seg1 = rt_getPoint2d_cp(ctx, pa, 0);
   seg2 = rt_getPoint2d_cp(ctx, pa, pa->npoints-1);
@@ -732,6 +1009,19 @@ ptarray_contains_point_partial(const RTCTX *ctx, const RTPOINTARRAY *pa, const R
 
   for ( i=1; i < pa->npoints; i++ )
   {
+    /* Skip segments out of our vertical range on the split y array */
+    if ( soa )
+    {
+      const double *ys = soa->y;
+      while ( i < pa->npoints &&
+              ( (pt->y > ys[i-1] && pt->y > ys[i]) ||
+                (pt->y < ys[i-1] && pt->y < ys[i]) ) )
+        i++;
+      if ( i == pa->npoints )
+        break;
+      seg1 = rt_getPoint2d_cp(ctx, pa, i-1);
+    }
+
     seg2 = rt_getPoint2d_cp(ctx, pa, i);
 
     /* Zero length segments are ignored. */
@@ -979,11 +1269,23 @@ ptarray_signed_area(const RTCTX *ctx, const RTPOINTARRAY *pa)
   const RTPOINT2D *P3;
   double sum = 0.0;
   double x0, x, y1, y2;
+  const RTPOINTARRAY_SOA *soa;
   int i;
 
   if (! pa || pa->npoints < 3 )
     return 0.0;
 
+  soa = RT_ATOMIC_LOAD_PTR(&pa->soa);
+  if ( soa )
+  {
+    const double *xs = soa->x;
+    const double *ys = soa->y;
+    x0 = xs[0];
+    for ( i = 1; i < pa->npoints - 1; i++ )
+      sum += (xs[i] - x0) * (ys[i-1] - ys[i+1]);
+    return sum / 2.0;
+  }
+
   P1 = rt_getPoint2d_cp(ctx, pa, 0);
   P2 = rt_getPoint2d_cp(ctx, pa, 1);
   x0 = P1->x;
@@ -1396,6 +1698,9 @@ ptarray_longitude_shift(const RTCTX *ctx, RTPOINTARRAY *pa)
   int i;
   double x;
 
+  ptarray_make_writable(ctx, pa);
+  ptarray_caches_clear(ctx, pa);
+
   for (i=0; i<pa->npoints; i++)
   {
     memcpy(&x, rt_getPoint_internal(ctx, pa, i), sizeof(double));
@@ -1406,6 +1711,38 @@ ptarray_longitude_shift(const RTCTX *ctx, RTPOINTARRAY *pa)
 }
 
 
+/*
+ * Copy the points of in to out, skipping those equal to the
+ * previous one, or closer than tolerance to the last kept one,
+ * while keeping at least minpoints. Returns the number kept.
+ */
+#define REMOVE_REPEATED_KERNEL(name, STRIDE, HASZ, HASM) \
+static uint32_t \
+name(const RTCTX *ctx, const double *in, uint32_t npoints, double *out, \
+     double tolerance, uint32_t minpoints) \
+{ \
+  const double *last_point = in; \
+  const double *this_point; \
+  double tolsq = tolerance * tolerance; \
+  uint32_t ipn, opn = 1; \
+  memcpy(out, in, STRIDE * sizeof(double)); \
+  for ( ipn = 1; ipn < npoints; ++ipn ) \
+  { \
+    this_point = in + ipn * STRIDE; \
+    if ( (ipn >= npoints-minpoints+1 && opn < minpoints) || \
+         (tolerance == 0 && memcmp(this_point - STRIDE, this_point, STRIDE * sizeof(double)) != 0) || \
+         (tolerance > 0.0 && distance2d_sqr_pt_pt(ctx, (const RTPOINT2D *)last_point, (const RTPOINT2D *)this_point) > tolsq) ) \
+    { \
+      /* The point is different from the previous, we add it to output */ \
+      memcpy(out + STRIDE * opn++, this_point, STRIDE * sizeof(double)); \
+      last_point = this_point; \
+    } \
+  } \
+  return opn; \
+}
+
+PTARRAY_SPECIALIZE(REMOVE_REPEATED_KERNEL, ptarray_remove_repeated)
+
 /*
  * Returns a RTPOINTARRAY with consecutive equal points
  * removed. Equality test on all dimensions of input.
@@ -1417,10 +1754,7 @@ RTPOINTARRAY *
 ptarray_remove_repeated_points_minpoints(const RTCTX *ctx, const RTPOINTARRAY *in, double tolerance, int minpoints)
 {
   RTPOINTARRAY* out;
-  size_t ptsize;
-  size_t ipn, opn;
-  const RTPOINT2D *last_point, *this_point;
-  double tolsq = tolerance * tolerance;
+  uint32_t opn;
 
   if ( minpoints < 1 ) minpoints = 1;
 
@@ -1429,34 +1763,13 @@ ptarray_remove_repeated_points_minpoints(const RTCTX *ctx, const RTPOINTARRAY *i
   /* Single or zero point arrays can't have duplicates */
   if ( in->npoints < 3 ) return ptarray_clone_deep(ctx, in);
 
-  ptsize = ptarray_point_size(ctx, in);
-
-  RTDEBUGF(ctx, 3, " ptsize: %d", ptsize);
-
   /* Allocate enough space for all points */
   out = ptarray_construct(ctx, RTFLAGS_GET_Z(in->flags),
                           RTFLAGS_GET_M(in->flags), in->npoints);
 
-  /* Now fill up the actual points (NOTE: could be optimized) */
-
-  opn=1;
-  memcpy(rt_getPoint_internal(ctx, out, 0), rt_getPoint_internal(ctx, in, 0), ptsize);
-  last_point = rt_getPoint2d_cp(ctx, in, 0);
-  RTDEBUGF(ctx, 3, " first point copied, out points: %d", opn);
-  for ( ipn = 1; ipn < in->npoints; ++ipn)
-  {
-    this_point = rt_getPoint2d_cp(ctx, in, ipn);
-    if ( (ipn >= in->npoints-minpoints+1 && opn < minpoints) ||
-         (tolerance == 0 && memcmp(rt_getPoint_internal(ctx, in, ipn-1), rt_getPoint_internal(ctx, in, ipn), ptsize) != 0) ||
-         (tolerance > 0.0 && distance2d_sqr_pt_pt(ctx, last_point, this_point) > tolsq) )
-    {
-      /* The point is different from the previous,
-       * we add it to output */
-      memcpy(rt_getPoint_internal(ctx, out, opn++), rt_getPoint_internal(ctx, in, ipn), ptsize);
-      last_point = this_point;
-      RTDEBUGF(ctx, 3, " Point %d differs from point %d. Out points: %d", ipn, ipn-1, opn);
-    }
-  }
+  opn = PTARRAY_DISPATCH(in->flags, ptarray_remove_repeated,
+                         (ctx, (const double *)in->serialized_pointlist, in->npoints,
+                          (double *)out->serialized_pointlist, tolerance, minpoints));
 
   RTDEBUGF(ctx, 3, " in:%d out:%d", out->npoints, opn);
   out->npoints = opn;
@@ -1470,109 +1783,85 @@ ptarray_remove_repeated_points(const RTCTX *ctx, const RTPOINTARRAY *in, double
   return ptarray_remove_repeated_points_minpoints(ctx, in, tolerance, 2);
 }
 
-static void
-ptarray_dp_findsplit(const RTCTX *ctx, RTPOINTARRAY *pts, int p1, int p2, int *split, double *dist)
-{
-  int k;
-  const RTPOINT2D *pk, *pa, *pb;
-  double tmp, d;
-
-  RTDEBUG(ctx, 4, "function called");
-
-  *split = p1;
-  d = -1;
-
-  if (p1 + 1 < p2)
-  {
-
-    pa = rt_getPoint2d_cp(ctx, pts, p1);
-    pb = rt_getPoint2d_cp(ctx, pts, p2);
-
-    RTDEBUGF(ctx, 4, "P%d(%f,%f) to P%d(%f,%f)",
-             p1, pa->x, pa->y, p2, pb->x, pb->y);
-
-    for (k=p1+1; k<p2; k++)
-    {
-      pk = rt_getPoint2d_cp(ctx, pts, k);
-
-      RTDEBUGF(ctx, 4, "P%d(%f,%f)", k, pk->x, pk->y);
-
-      /* distance computation */
-      tmp = distance2d_sqr_pt_seg(ctx, pk, pa, pb);
-
-      if (tmp > d)
-      {
-        d = tmp;  /* record the maximum */
-        *split = k;
-
-        RTDEBUGF(ctx, 4, "P%d is farthest (%g)", k, d);
-      }
-    }
-    *dist = d;
-
-  } /* length---should be redone if can == 0 */
-  else
-  {
-    RTDEBUG(ctx, 3, "segment too short, no split/no dist");
-    *dist = -1;
-  }
-
+/*
+ * Douglas-Peucker simplification of the npoints points of in into
+ * out, which has room for all of them. Distances are 2D, and
+ * consecutive equal points are not repeated.
+ * Returns the number of points written.
+ */
+#define SIMPLIFY_KERNEL(name, STRIDE, HASZ, HASM) \
+static uint32_t \
+name(const RTCTX *ctx, const double *in, uint32_t npoints, double *out, \
+     int *stack, double eps_sqr, uint32_t minpts) \
+{ \
+  int sp = -1; /* recursion stack pointer */ \
+  int p1 = 0, p2, split, k; \
+  uint32_t opn = 1; \
+  double dist, tmp; \
+  const double *pa, *pb; \
+  stack[++sp] = npoints-1; \
+  memcpy(out, in, STRIDE * sizeof(double)); \
+  do \
+  { \
+    /* Find the point farthest from segment p1-p2 */ \
+    p2 = stack[sp]; \
+    split = p1; \
+    dist = -1; \
+    if ( p1 + 1 < p2 ) \
+    { \
+      pa = in + p1 * STRIDE; \
+      pb = in + p2 * STRIDE; \
+      for ( k = p1+1; k < p2; k++ ) \
+      { \
+        tmp = distance2d_sqr_pt_seg(ctx, (const RTPOINT2D *)(in + k * STRIDE), \
+                                    (const RTPOINT2D *)pa, (const RTPOINT2D *)pb); \
+        if ( tmp > dist ) \
+        { \
+          dist = tmp; /* record the maximum */ \
+          split = k; \
+        } \
+      } \
+    } \
+    if ( dist > eps_sqr || ( opn+sp+1 < minpts && dist >= 0 ) ) \
+    { \
+      stack[++sp] = split; \
+    } \
+    else \
+    { \
+      if ( ! ptarray_point_same(out + STRIDE * (opn-1), in + p2 * STRIDE, STRIDE) ) \
+        memcpy(out + STRIDE * opn++, in + p2 * STRIDE, STRIDE * sizeof(double)); \
+      p1 = stack[sp--]; \
+    } \
+  } \
+  while ( ! (sp < 0) ); \
+  return opn; \
 }
 
+PTARRAY_SPECIALIZE(SIMPLIFY_KERNEL, ptarray_simplify)
+
 RTPOINTARRAY *
 ptarray_simplify(const RTCTX *ctx, RTPOINTARRAY *inpts, double epsilon, unsigned int minpts)
 {
   int *stack;      /* recursion stack */
-  int sp=-1;      /* recursion stack pointer */
-  int p1, split;
-  double dist;
   RTPOINTARRAY *outpts;
-  RTPOINT4D pt;
 
   double eps_sqr = epsilon * epsilon;
 
-  /* Allocate recursion stack */
-  stack = rtalloc(ctx, sizeof(int)*inpts->npoints);
-
-  p1 = 0;
-  stack[++sp] = inpts->npoints-1;
-
   RTDEBUGF(ctx, 2, "Input has %d pts and %d dims", inpts->npoints,
                                               RTFLAGS_NDIMS(inpts->flags));
 
-  /* Allocate output RTPOINTARRAY, and add first point. */
+  /* Allocate output RTPOINTARRAY, room for all points */
   outpts = ptarray_construct_empty(ctx, RTFLAGS_GET_Z(inpts->flags), RTFLAGS_GET_M(inpts->flags), inpts->npoints);
-  rt_getPoint4d_p(ctx, inpts, 0, &pt);
-  ptarray_append_point(ctx, outpts, &pt, RT_FALSE);
-
-  RTDEBUG(ctx, 3, "Added P0 to simplified point array (size 1)");
-
-  do
-  {
-
-    ptarray_dp_findsplit(ctx, inpts, p1, stack[sp], &split, &dist);
+  if ( inpts->npoints < 1 ) return outpts;
 
-    RTDEBUGF(ctx, 3, "Farthest point from P%d-P%d is P%d (dist. %g)", p1, stack[sp], split, dist);
-
-    if (dist > eps_sqr || ( outpts->npoints+sp+1 < minpts && dist >= 0 ) )
-    {
-      RTDEBUGF(ctx, 4, "Added P%d to stack (outpts:%d)", split, sp);
-      stack[++sp] = split;
-    }
-    else
-    {
-      rt_getPoint4d_p(ctx, inpts, stack[sp], &pt);
-      RTDEBUGF(ctx, 4, "npoints , minpoints %d %d", outpts->npoints, minpts);
-      ptarray_append_point(ctx, outpts, &pt, RT_FALSE);
-
-      RTDEBUGF(ctx, 4, "Added P%d to simplified point array (size: %d)", stack[sp], outpts->npoints);
+  /* Allocate recursion stack */
+  stack = rtalloc(ctx, sizeof(int)*inpts->npoints);
 
-      p1 = stack[sp--];
-    }
+  outpts->npoints = PTARRAY_DISPATCH(inpts->flags, ptarray_simplify,
+                                     (ctx, (const double *)inpts->serialized_pointlist, inpts->npoints,
+                                      (double *)outpts->serialized_pointlist, stack, eps_sqr, minpts));
 
-    RTDEBUGF(ctx, 4, "stack pointer = %d", sp);
-  }
-  while (! (sp<0) );
+  RTDEBUGF(ctx, 3, "Simplified to %d points", outpts->npoints);
 
   rtfree(ctx, stack);
   return outpts;
@@ -1607,6 +1896,37 @@ ptarray_arc_length_2d(const RTCTX *ctx, const RTPOINTARRAY *pts)
   return dist;
 }
 
+/*
+ * Length of the npoints points starting at d, 3D when USEZ is
+ * non zero and the points have a Z, 2D otherwise.
+ */
+#define LENGTH_KERNEL(name, STRIDE, USEZ) \
+static double \
+name(const double *d, uint32_t npoints) \
+{ \
+  double dist = 0.0; \
+  uint32_t i; \
+  for ( i = 1; i < npoints; i++, d += STRIDE ) \
+  { \
+    if ( USEZ ) \
+      dist += sqrt( ((d[0] - d[STRIDE])*(d[0] - d[STRIDE])) + \
+                    ((d[1] - d[STRIDE+1])*(d[1] - d[STRIDE+1])) + \
+                    ((d[2] - d[STRIDE+2])*(d[2] - d[STRIDE+2])) ); \
+    else \
+      dist += sqrt( ((d[0] - d[STRIDE])*(d[0] - d[STRIDE])) + \
+                    ((d[1] - d[STRIDE+1])*(d[1] - d[STRIDE+1])) ); \
+  } \
+  return dist; \
+}
+
+#define LENGTH_2D_KERNEL(name, STRIDE, HASZ, HASM) LENGTH_KERNEL(name, STRIDE, 0)
+#define LENGTH_3D_KERNEL(name, STRIDE, HASZ, HASM) LENGTH_KERNEL(name, STRIDE, HASZ)
+
+PTARRAY_SPECIALIZE(LENGTH_2D_KERNEL, ptarray_length_2d)
+/* 3D length is only computed for arrays with a Z */
+LENGTH_3D_KERNEL(ptarray_length_3d_3dz, 3, 1, 0)
+LENGTH_3D_KERNEL(ptarray_length_3d_4d, 4, 1, 1)
+
 /**
 * Find the 2d length of the given #RTPOINTARRAY (even if it's 3d)
 */
@@ -1614,24 +1934,24 @@ double
 ptarray_length_2d(const RTCTX *ctx, const RTPOINTARRAY *pts)
 {
   double dist = 0.0;
+  const RTPOINTARRAY_SOA *soa;
   int i;
-  const RTPOINT2D *frm;
-  const RTPOINT2D *to;
 
   if ( pts->npoints < 2 ) return 0.0;
 
-  frm = rt_getPoint2d_cp(ctx, pts, 0);
-
-  for ( i=1; i < pts->npoints; i++ )
+  soa = RT_ATOMIC_LOAD_PTR(&pts->soa);
+  if ( soa )
   {
-    to = rt_getPoint2d_cp(ctx, pts, i);
-
-    dist += sqrt( ((frm->x - to->x)*(frm->x - to->x))  +
-                  ((frm->y - to->y)*(frm->y - to->y)) );
-
-    frm = to;
+    const double *xs = soa->x;
+    const double *ys = soa->y;
+    for ( i=1; i < pts->npoints; i++ )
+      dist += sqrt( ((xs[i-1] - xs[i])*(xs[i-1] - xs[i])) +
+                    ((ys[i-1] - ys[i])*(ys[i-1] - ys[i])) );
+    return dist;
   }
-  return dist;
+
+  return PTARRAY_DISPATCH(pts->flags, ptarray_length_2d,
+                          ((const double *)pts->serialized_pointlist, pts->npoints));
 }
 
 /**
@@ -1641,26 +1961,14 @@ ptarray_length_2d(const RTCTX *ctx, const RTPOINTARRAY *pts)
 double
 ptarray_length(const RTCTX *ctx, const RTPOINTARRAY *pts)
 {
-  double dist = 0.0;
-  int i;
-  RTPOINT3DZ frm;
-  RTPOINT3DZ to;
-
   if ( pts->npoints < 2 ) return 0.0;
 
   /* compute 2d length if 3d is not available */
   if ( ! RTFLAGS_GET_Z(pts->flags) ) return ptarray_length_2d(ctx, pts);
 
-  rt_getPoint3dz_p(ctx, pts, 0, &frm);
-  for ( i=1; i < pts->npoints; i++ )
-  {
-    rt_getPoint3dz_p(ctx, pts, i, &to);
-    dist += sqrt( ((frm.x - to.x)*(frm.x - to.x)) +
-                  ((frm.y - to.y)*(frm.y - to.y)) +
-                  ((frm.z - to.z)*(frm.z - to.z)) );
-    frm = to;
-  }
-  return dist;
+  if ( RTFLAGS_GET_M(pts->flags) )
+    return ptarray_length_3d_4d((const double *)pts->serialized_pointlist, pts->npoints);
+  return ptarray_length_3d_3dz((const double *)pts->serialized_pointlist, pts->npoints);
 }
 
 
@@ -1800,6 +2108,42 @@ ptarray_startpoint(const RTCTX *ctx, const RTPOINTARRAY* pa, RTPOINT4D* pt)
 
 
 
+/*
+ * Snap the npoints points of in to grid, writing them to out
+ * without repeating consecutive equal points.
+ * Returns the number of points written.
+ */
+#define GRID_KERNEL(name, STRIDE, HASZ, HASM) \
+static uint32_t \
+name(const double *in, uint32_t npoints, double *out, const gridspec *grid) \
+{ \
+  uint32_t ipn, opn = 0; \
+  for ( ipn = 0; ipn < npoints; ++ipn, in += STRIDE ) \
+  { \
+    memcpy(out, in, STRIDE * sizeof(double)); \
+    if ( grid->xsize ) \
+      out[0] = rint((in[0] - grid->ipx)/grid->xsize) * \
+               grid->xsize + grid->ipx; \
+    if ( grid->ysize ) \
+      out[1] = rint((in[1] - grid->ipy)/grid->ysize) * \
+               grid->ysize + grid->ipy; \
+    if ( HASZ && grid->zsize ) \
+      out[2] = rint((in[2] - grid->ipz)/grid->zsize) * \
+               grid->zsize + grid->ipz; \
+    if ( HASM && grid->msize ) \
+      out[2+HASZ] = rint((in[2+HASZ] - grid->ipm)/grid->msize) * \
+                    grid->msize + grid->ipm; \
+    if ( opn == 0 || ! ptarray_point_same(out - STRIDE, out, STRIDE) ) \
+    { \
+      out += STRIDE; \
+      opn++; \
+    } \
+  } \
+  return opn; \
+}
+
+PTARRAY_SPECIALIZE(GRID_KERNEL, ptarray_grid)
+
 /*
  * Stick an array of points to the given gridspec.
  * Return "gridded" points in *outpts and their number in *outptsn.
@@ -1811,38 +2155,16 @@ ptarray_startpoint(const RTCTX *ctx, const RTPOINTARRAY* pa, RTPOINT4D* pt)
 RTPOINTARRAY *
 ptarray_grid(const RTCTX *ctx, const RTPOINTARRAY *pa, const gridspec *grid)
 {
-  RTPOINT4D pt;
-  int ipn; /* input point numbers */
   RTPOINTARRAY *dpa;
 
   RTDEBUGF(ctx, 2, "ptarray_grid called on %p", pa);
 
   dpa = ptarray_construct_empty(ctx, RTFLAGS_GET_Z(pa->flags),RTFLAGS_GET_M(pa->flags), pa->npoints);
+  if ( pa->npoints < 1 ) return dpa;
 
-  for (ipn=0; ipn<pa->npoints; ++ipn)
-  {
-
-    rt_getPoint4d_p(ctx, pa, ipn, &pt);
-
-    if ( grid->xsize )
-      pt.x = rint((pt.x - grid->ipx)/grid->xsize) *
-               grid->xsize + grid->ipx;
-
-    if ( grid->ysize )
-      pt.y = rint((pt.y - grid->ipy)/grid->ysize) *
-               grid->ysize + grid->ipy;
-
-    if ( RTFLAGS_GET_Z(pa->flags) && grid->zsize )
-      pt.z = rint((pt.z - grid->ipz)/grid->zsize) *
-               grid->zsize + grid->ipz;
-
-    if ( RTFLAGS_GET_M(pa->flags) && grid->msize )
-      pt.m = rint((pt.m - grid->ipm)/grid->msize) *
-               grid->msize + grid->ipm;
-
-    ptarray_append_point(ctx, dpa, &pt, RT_FALSE);
-
-  }
+  dpa->npoints = PTARRAY_DISPATCH(pa->flags, ptarray_grid,
+                                  ((const double *)pa->serialized_pointlist, pa->npoints,
+                                   (double *)dpa->serialized_pointlist, grid));
 
   return dpa;
 }
@@ -264,6 +264,7 @@ void
 rtcircstring_setPoint4d(const RTCTX *ctx, RTCIRCSTRING *curve, uint32_t index, RTPOINT4D *newpoint)
 {
   ptarray_set_point4d(ctx, curve->points, index, newpoint);
+  rtgeom_drop_bbox(ctx, (RTGEOM*)curve);
 }
 
 int
@@ -28,6 +28,7 @@
 #include "rttopo_config.h"
 #include "librttopo_geom_internal.h"
 #include "rtgeodetic.h"
+#include "rtgeodetic_tree.h"
 #include "rtgeom_log.h"
 
 /**
@@ -682,53 +683,45 @@ edge_point_side(const RTCTX *ctx, const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POI
 }
 
 /**
-* Returns the angle in radians at point B of the triangle formed by A-B-C
-*/
-static double
-sphere_angle(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b,  const GEOGRAPHIC_POINT *c)
-{
-  POINT3D normal1, normal2;
-  robust_cross_product(ctx, b, a, &normal1);
-  robust_cross_product(ctx, b, c, &normal2);
-  normalize(ctx, &normal1);
-  normalize(ctx, &normal2);
-  return sphere_distance_cartesian(ctx, &normal1, &normal2);
-}
-
-/**
-* Computes the spherical area of a triangle. If C is to the left of A/B,
-* the area is negative. If C is to the right of A/B, the area is positive.
+* Computes the spherical area of a triangle, given its vertices on the
+* unit sphere, using the formula of Van Oosterom and Strackee:
+* tan(E/2) = A.(B x C) / (1 + A.B + B.C + C.A)
+* If C is to the left of A/B, the area is negative. If C is to the
+* right of A/B, the area is positive.
 *
 * @param a The first triangle vertex.
 * @param b The second triangle vertex.
 * @param c The last triangle vertex.
 * @return the signed area in radians.
 */
-static double
-sphere_signed_area(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, const GEOGRAPHIC_POINT *c)
+static inline double
+sphere_signed_area(const POINT3D *a, const POINT3D *b, const POINT3D *c)
 {
-  double angle_a, angle_b, angle_c;
-  double area_radians = 0.0;
-  int side;
-  GEOGRAPHIC_EDGE e;
-
-  angle_a = sphere_angle(ctx, b,a,c);
-  angle_b = sphere_angle(ctx, a,b,c);
-  angle_c = sphere_angle(ctx, b,c,a);
-
-  area_radians = angle_a + angle_b + angle_c - M_PI;
-
-  /* What's the direction of the B/C edge? */
-  e.start = *a;
-  e.end = *b;
-  side = edge_point_side(ctx, &e, c);
+  double triple = a->x * (b->y * c->z - b->z * c->y) +
+                  a->y * (b->z * c->x - b->x * c->z) +
+                  a->z * (b->x * c->y - b->y * c->x);
+  double denom = 1.0 + (a->x * b->x + a->y * b->y + a->z * b->z) +
+                       (b->x * c->x + b->y * c->y + b->z * c->z) +
+                       (c->x * a->x + c->y * a->y + c->z * a->z);
 
   /* Co-linear points implies no area */
-  if ( side == 0 )
+  if ( triple == 0.0 )
     return 0.0;
 
-  /* Add the sign to the area */
-  return side * area_radians;
+  return -2.0 * atan2(triple, denom);
+}
+
+/**
+* Adds v to a compensated (Kahan) sum, so that long runs of small
+* terms, like the triangles of large rings, do not lose precision.
+*/
+static inline void
+area_sum_add(double *sum, double *err, double v)
+{
+  double y = v - *err;
+  double t = *sum + y;
+  *err = (t - *sum) - y;
+  *sum = t;
 }
 
 
@@ -1540,14 +1533,81 @@ void gbox_pt_outside(const RTCTX *ctx, const RTGBOX *gbox, RTPOINT2D *pt_outside
 
 
 /**
-* Create a new point array with no segment longer than the input segment length (expressed in radians!)
-* @param pa_in - input point array pointer
-* @param max_seg_length - maximum output segment length in radians
+* State of a densification in progress: the output sink and the last
+* vertex handed to it, to drop consecutive duplicates on the way out.
 */
-static RTPOINTARRAY*
-ptarray_segmentize_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double max_seg_length)
+typedef struct
+{
+  rtsegmentize_callback cb;
+  void *arg;
+  int part;
+  int hasz;
+  int hasm;
+  int nemitted;
+  RTPOINT4D last;
+} SEGMENTIZE_SINK;
+
+static int
+segmentize_sink_emit(const RTCTX *ctx, SEGMENTIZE_SINK *sink, const RTPOINT4D *pt, int repeated_points)
+{
+  /* Same rule as ptarray_append_point for duplicate end points */
+  if ( repeated_points == RT_FALSE && sink->nemitted > 0 &&
+       pt->x == sink->last.x && pt->y == sink->last.y &&
+       (sink->hasz ? pt->z == sink->last.z : 1) &&
+       (sink->hasm ? pt->m == sink->last.m : 1) )
+  {
+    return RT_TRUE;
+  }
+  sink->last = *pt;
+  sink->nemitted++;
+  return sink->cb(ctx, sink->part, pt, sink->arg);
+}
+
+/**
+* Number of vertices the densification of pa_in can produce, an upper
+* bound that only overshoots when interpolated vertices coincide.
+*/
+static int
+ptarray_segmentize_sphere_size(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double max_seg_length)
+{
+  RTPOINT4D p1, p2;
+  GEOGRAPHIC_POINT g1, g2;
+  double d, npoints = 1;
+  int i;
+
+  if ( pa_in->npoints < 1 )
+    return 0;
+
+  rt_getPoint4d_p(ctx, pa_in, 0, &p1);
+  geographic_point_init(ctx, p1.x, p1.y, &g1);
+
+  for ( i = 1; i < pa_in->npoints; i++ )
+  {
+    rt_getPoint4d_p(ctx, pa_in, i, &p2);
+    geographic_point_init(ctx, p2.x, p2.y, &g2);
+    if ( ! ( (pa_in->npoints > 2) && p4d_same(ctx, &p1, &p2) ) )
+    {
+      d = sphere_distance(ctx, &g1, &g2);
+      npoints += ( d > max_seg_length ) ? (int)(1 + d / max_seg_length) : 1;
+    }
+    p1 = p2;
+    g1 = g2;
+  }
+
+  if ( npoints > INT32_MAX )
+    rterror(ctx, "ptarray_segmentize_sphere: output would exceed %d points", INT32_MAX);
+  return (int)npoints;
+}
+
+/**
+* Hand every vertex of the densification of pa_in to the sink, so that
+* no segment is longer than max_seg_length (expressed in radians!)
+* @return RT_FALSE if the sink asked to stop or on interruption,
+*         RT_TRUE otherwise
+*/
+static int
+ptarray_segmentize_sphere_walk(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double max_seg_length, SEGMENTIZE_SINK *sink)
 {
-  RTPOINTARRAY *pa_out;
   int hasz = ptarray_has_z(ctx, pa_in);
   int hasm = ptarray_has_m(ctx, pa_in);
   int pa_in_offset = 0; /* input point offset */
@@ -1556,23 +1616,21 @@ ptarray_segmentize_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double ma
   GEOGRAPHIC_POINT g1, g2, g;
   double d;
 
-  /* Just crap out on crazy input */
-  if ( ! pa_in )
-    rterror(ctx, "ptarray_segmentize_sphere: null input pointarray");
-  if ( max_seg_length <= 0.0 )
-    rterror(ctx, "ptarray_segmentize_sphere: maximum segment length must be positive");
-
-  /* Empty starting array */
-  pa_out = ptarray_construct_empty(ctx, hasz, hasm, pa_in->npoints);
+  sink->hasz = hasz;
+  sink->hasm = hasm;
+  sink->nemitted = 0;
 
   /* Add first point */
   rt_getPoint4d_p(ctx, pa_in, pa_in_offset, &p1);
-  ptarray_append_point(ctx, pa_out, &p1, RT_FALSE);
+  if ( ! segmentize_sink_emit(ctx, sink, &p1, RT_FALSE) )
+    return RT_FALSE;
   geographic_point_init(ctx, p1.x, p1.y, &g1);
   pa_in_offset++;
 
   while ( pa_in_offset < pa_in->npoints )
   {
+    RT_ON_INTERRUPT(return RT_FALSE);
+
     rt_getPoint4d_p(ctx, pa_in, pa_in_offset, &p2);
     geographic_point_init(ctx, p2.x, p2.y, &g2);
 
@@ -1626,15 +1684,18 @@ ptarray_segmentize_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double ma
           p.z += dzz;
         if ( hasm )
           p.m += dmm;
-        ptarray_append_point(ctx, pa_out, &p, RT_FALSE);
+        if ( ! segmentize_sink_emit(ctx, sink, &p, RT_FALSE) )
+          return RT_FALSE;
       }
 
-      ptarray_append_point(ctx, pa_out, &p2, RT_FALSE);
+      if ( ! segmentize_sink_emit(ctx, sink, &p2, RT_FALSE) )
+        return RT_FALSE;
     }
     /* This edge is already short enough */
     else
     {
-      ptarray_append_point(ctx, pa_out, &p2, (pa_in->npoints==2)?RT_TRUE:RT_FALSE);
+      if ( ! segmentize_sink_emit(ctx, sink, &p2, (pa_in->npoints==2)?RT_TRUE:RT_FALSE) )
+        return RT_FALSE;
     }
 
     /* Move one offset forward */
@@ -1643,6 +1704,49 @@ ptarray_segmentize_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double ma
     pa_in_offset++;
   }
 
+  return RT_TRUE;
+}
+
+static int
+segmentize_append_point(const RTCTX *ctx, int part, const RTPOINT4D *pt, void *arg)
+{
+  /* Duplicates were already dropped by the sink */
+  return ptarray_append_point(ctx, (RTPOINTARRAY*)arg, pt, RT_TRUE) == RT_SUCCESS;
+}
+
+/**
+* Create a new point array with no segment longer than the input segment length (expressed in radians!)
+* The output is sized in a first pass over the edge lengths, so it never
+* needs to grow while being filled.
+* @param pa_in - input point array pointer
+* @param max_seg_length - maximum output segment length in radians
+* @return the new point array, or NULL if interrupted
+*/
+static RTPOINTARRAY*
+ptarray_segmentize_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double max_seg_length)
+{
+  RTPOINTARRAY *pa_out;
+  SEGMENTIZE_SINK sink;
+
+  /* Just crap out on crazy input */
+  if ( ! pa_in )
+    rterror(ctx, "ptarray_segmentize_sphere: null input pointarray");
+  if ( max_seg_length <= 0.0 )
+    rterror(ctx, "ptarray_segmentize_sphere: maximum segment length must be positive");
+
+  /* Empty starting array, large enough for the whole output */
+  pa_out = ptarray_construct_empty(ctx, ptarray_has_z(ctx, pa_in), ptarray_has_m(ctx, pa_in),
+                                   ptarray_segmentize_sphere_size(ctx, pa_in, max_seg_length));
+
+  sink.cb = segmentize_append_point;
+  sink.arg = pa_out;
+  sink.part = 0;
+  if ( ! ptarray_segmentize_sphere_walk(ctx, pa_in, max_seg_length, &sink) )
+  {
+    ptarray_free(ctx, pa_out);
+    return NULL;
+  }
+
   return pa_out;
 }
 
@@ -1651,6 +1755,7 @@ ptarray_segmentize_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa_in, double ma
 * Input geometry is not altered, output geometry must be freed by caller.
 * @param rtg_in = input geometry
 * @param max_seg_length = maximum segment length in radians
+* @return the new geometry, or NULL if interrupted
 */
 RTGEOM*
 rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_length)
@@ -1678,6 +1783,7 @@ rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_
   case RTLINETYPE:
     rtline = rtgeom_as_rtline(ctx, rtg_in);
     pa_out = ptarray_segmentize_sphere(ctx, rtline->points, max_seg_length);
+    if ( ! pa_out ) return NULL;
     return rtline_as_rtgeom(ctx, rtline_construct(ctx, rtg_in->srid, NULL, pa_out));
     break;
   case RTPOLYGONTYPE:
@@ -1686,6 +1792,11 @@ rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_
     for ( i = 0; i < rtpoly_in->nrings; i++ )
     {
       pa_out = ptarray_segmentize_sphere(ctx, rtpoly_in->rings[i], max_seg_length);
+      if ( ! pa_out )
+      {
+        rtpoly_free(ctx, rtpoly_out);
+        return NULL;
+      }
       rtpoly_add_ring(ctx, rtpoly_out, pa_out);
     }
     return rtpoly_as_rtgeom(ctx, rtpoly_out);
@@ -1697,7 +1808,13 @@ rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_
     rtcol_out = rtcollection_construct_empty(ctx, rtg_in->type, rtg_in->srid, rtgeom_has_z(ctx, rtg_in), rtgeom_has_m(ctx, rtg_in));
     for ( i = 0; i < rtcol_in->ngeoms; i++ )
     {
-      rtcollection_add_rtgeom(ctx, rtcol_out, rtgeom_segmentize_sphere(ctx, rtcol_in->geoms[i], max_seg_length));
+      RTGEOM *rtg_out = rtgeom_segmentize_sphere(ctx, rtcol_in->geoms[i], max_seg_length);
+      if ( ! rtg_out )
+      {
+        rtcollection_free(ctx, rtcol_out);
+        return NULL;
+      }
+      rtcollection_add_rtgeom(ctx, rtcol_out, rtg_out);
     }
     return rtcollection_as_rtgeom(ctx, rtcol_out);
     break;
@@ -1711,6 +1828,92 @@ rtgeom_segmentize_sphere(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_
   return NULL;
 }
 
+static int
+rtgeom_segmentize_sphere_walk(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_length, SEGMENTIZE_SINK *sink)
+{
+  RTPOLY *rtpoly_in;
+  RTCOLLECTION *rtcol_in;
+  const RTPOINTARRAY *pa;
+  int i;
+
+  switch (rtg_in->type)
+  {
+  case RTPOINTTYPE:
+    pa = ((RTPOINT*)rtg_in)->point;
+    if ( pa->npoints < 1 )
+      return RT_TRUE;
+    if ( ! ptarray_segmentize_sphere_walk(ctx, pa, max_seg_length, sink) )
+      return RT_FALSE;
+    sink->part++;
+    return RT_TRUE;
+  case RTLINETYPE:
+    pa = ((RTLINE*)rtg_in)->points;
+    if ( pa->npoints < 1 )
+      return RT_TRUE;
+    if ( ! ptarray_segmentize_sphere_walk(ctx, pa, max_seg_length, sink) )
+      return RT_FALSE;
+    sink->part++;
+    return RT_TRUE;
+  case RTPOLYGONTYPE:
+    rtpoly_in = (RTPOLY*)rtg_in;
+    for ( i = 0; i < rtpoly_in->nrings; i++ )
+    {
+      if ( rtpoly_in->rings[i]->npoints < 1 )
+        continue;
+      if ( ! ptarray_segmentize_sphere_walk(ctx, rtpoly_in->rings[i], max_seg_length, sink) )
+        return RT_FALSE;
+      sink->part++;
+    }
+    return RT_TRUE;
+  case RTMULTIPOINTTYPE:
+  case RTMULTILINETYPE:
+  case RTMULTIPOLYGONTYPE:
+  case RTCOLLECTIONTYPE:
+    rtcol_in = (RTCOLLECTION*)rtg_in;
+    for ( i = 0; i < rtcol_in->ngeoms; i++ )
+    {
+      if ( ! rtgeom_segmentize_sphere_walk(ctx, rtcol_in->geoms[i], max_seg_length, sink) )
+        return RT_FALSE;
+    }
+    return RT_TRUE;
+  default:
+    rterror(ctx, "rtgeom_segmentize_sphere_stream: unsupported input geometry type: %d - %s",
+            rtg_in->type, rttype_name(ctx, rtg_in->type));
+    break;
+  }
+
+  return RT_FALSE;
+}
+
+/**
+* Densify a geometry like rtgeom_segmentize_sphere, handing the output
+* vertices to cb as they are computed instead of building a geometry.
+* Every point, line and ring is a new part, numbered from zero.
+* @return RT_SUCCESS, or RT_FAILURE if cb stopped the traversal
+*         or it was interrupted
+*/
+int
+rtgeom_segmentize_sphere_stream(const RTCTX *ctx, const RTGEOM *rtg_in, double max_seg_length, rtsegmentize_callback cb, void *arg)
+{
+  SEGMENTIZE_SINK sink;
+
+  if ( ! rtg_in || ! cb )
+  {
+    rterror(ctx, "rtgeom_segmentize_sphere_stream: null input");
+    return RT_FAILURE;
+  }
+  if ( max_seg_length <= 0.0 )
+  {
+    rterror(ctx, "rtgeom_segmentize_sphere_stream: maximum segment length must be positive");
+    return RT_FAILURE;
+  }
+
+  sink.cb = cb;
+  sink.arg = arg;
+  sink.part = 0;
+  return rtgeom_segmentize_sphere_walk(ctx, rtg_in, max_seg_length, &sink) ? RT_SUCCESS : RT_FAILURE;
+}
+
 
 /**
 * Returns the area of the ring (ring must be closed) in square radians (surface of
@@ -1720,26 +1923,17 @@ double
 ptarray_area_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa)
 {
   int i;
-  const RTPOINT2D *p;
-  GEOGRAPHIC_POINT a, b, c;
-  double area = 0.0;
+  const POINT3D *pts;
+  double area = 0.0, err = 0.0;
 
   /* Return zero on nonsensical inputs */
   if ( ! pa || pa->npoints < 4 )
     return 0.0;
 
-  p = rt_getPoint2d_cp(ctx, pa, 0);
-  geographic_point_init(ctx, p->x, p->y, &a);
-  p = rt_getPoint2d_cp(ctx, pa, 1);
-  geographic_point_init(ctx, p->x, p->y, &b);
-
+  /* Fan of triangles from the first vertex, the closing one excluded */
+  pts = ptarray_geocentric_points(ctx, pa);
   for ( i = 2; i < pa->npoints-1; i++ )
-  {
-    p = rt_getPoint2d_cp(ctx, pa, i);
-    geographic_point_init(ctx, p->x, p->y, &c);
-    area += sphere_signed_area(ctx, &a, &b, &c);
-    b = c;
-  }
+    area_sum_add(&area, &err, sphere_signed_area(&pts[0], &pts[i-1], &pts[i]));
 
   return fabs(area);
 }
@@ -1751,6 +1945,7 @@ static double ptarray_distance_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa
   GEOGRAPHIC_POINT g1, g2;
   GEOGRAPHIC_POINT nearest1, nearest2;
   POINT3D A1, A2, B1, B2;
+  const POINT3D *pts1, *pts2;
   const RTPOINT2D *p;
   double distance;
   int i, j;
@@ -1857,23 +2052,29 @@ static double ptarray_distance_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa
 
   }
 
+  /* Unit sphere coordinates of both lines, computed once */
+  pts1 = ptarray_geocentric_points(ctx, pa1);
+  pts2 = ptarray_geocentric_points(ctx, pa2);
+
   /* Initialize start of line 1 */
   p = rt_getPoint2d_cp(ctx, pa1, 0);
   geographic_point_init(ctx, p->x, p->y, &(e1.start));
-  geog2cart(ctx, &(e1.start), &A1);
+  A1 = pts1[0];
 
 
   /* Handle line/line case */
   for ( i = 1; i < pa1->npoints; i++ )
   {
+    RT_ON_INTERRUPT(return -1.0);
+
     p = rt_getPoint2d_cp(ctx, pa1, i);
     geographic_point_init(ctx, p->x, p->y, &(e1.end));
-    geog2cart(ctx, &(e1.end), &A2);
+    A2 = pts1[i];
 
     /* Initialize start of line 2 */
     p = rt_getPoint2d_cp(ctx, pa2, 0);
     geographic_point_init(ctx, p->x, p->y, &(e2.start));
-    geog2cart(ctx, &(e2.start), &B1);
+    B1 = pts2[0];
 
     for ( j = 1; j < pa2->npoints; j++ )
     {
@@ -1881,7 +2082,7 @@ static double ptarray_distance_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa
 
       p = rt_getPoint2d_cp(ctx, pa2, j);
       geographic_point_init(ctx, p->x, p->y, &(e2.end));
-      geog2cart(ctx, &(e2.end), &B2);
+      B2 = pts2[j];
 
       RTDEBUGF(ctx, 4, "e1.start == GPOINT(%.6g %.6g) ", e1.start.lat, e1.start.lon);
       RTDEBUGF(ctx, 4, "e1.end == GPOINT(%.6g %.6g) ", e1.end.lat, e1.end.lon);
@@ -1963,19 +2164,19 @@ double rtgeom_area_sphere(const RTCTX *ctx, const RTGEOM *rtgeom, const SPHEROID
   {
     RTPOLY *poly = (RTPOLY*)rtgeom;
     int i;
-    double area = 0.0;
+    double area = 0.0, err = 0.0;
 
     /* Just in case there's no rings */
     if ( poly->nrings < 1 )
       return 0.0;
 
     /* First, the area of the outer ring */
-    area += radius2 * ptarray_area_sphere(ctx, poly->rings[0]);
+    area_sum_add(&area, &err, radius2 * ptarray_area_sphere(ctx, poly->rings[0]));
 
     /* Subtract areas of inner rings */
     for ( i = 1; i < poly->nrings; i++ )
     {
-      area -= radius2 * ptarray_area_sphere(ctx, poly->rings[i]);
+      area_sum_add(&area, &err, -radius2 * ptarray_area_sphere(ctx, poly->rings[i]));
     }
     return area;
   }
@@ -1985,11 +2186,11 @@ double rtgeom_area_sphere(const RTCTX *ctx, const RTGEOM *rtgeom, const SPHEROID
   {
     RTCOLLECTION *col = (RTCOLLECTION*)rtgeom;
     int i;
-    double area = 0.0;
+    double area = 0.0, err = 0.0;
 
     for ( i = 0; i < col->ngeoms; i++ )
     {
-      area += rtgeom_area_sphere(ctx, col->geoms[i], spheroid);
+      area_sum_add(&area, &err, rtgeom_area_sphere(ctx, col->geoms[i], spheroid));
     }
     return area;
   }
@@ -2088,6 +2289,46 @@ double rtgeom_azumith_spheroid(const RTCTX *ctx, const RTPOINT *r, const RTPOINT
   return spheroid_direction(ctx, &g1, &g2, spheroid);
 }
 
+/**
+* Gathers the locations of a POINT or MULTIPOINT into a new array
+* and returns their number, or -1 for other types.
+*/
+static int rtgeom_geographic_points(const RTCTX *ctx, const RTGEOM *rtgeom, GEOGRAPHIC_POINT **points)
+{
+  const RTPOINT2D *p;
+  int i, n = 0;
+
+  if ( rtgeom->type == RTPOINTTYPE )
+  {
+    *points = rtalloc(ctx, sizeof(GEOGRAPHIC_POINT));
+    p = rt_getPoint2d_cp(ctx, ((RTPOINT*)rtgeom)->point, 0);
+    geographic_point_init(ctx, p->x, p->y, *points);
+    return 1;
+  }
+
+  if ( rtgeom->type == RTMULTIPOINTTYPE )
+  {
+    RTMPOINT *mpt = (RTMPOINT*)rtgeom;
+    *points = rtalloc(ctx, sizeof(GEOGRAPHIC_POINT) * (mpt->ngeoms ? mpt->ngeoms : 1));
+    for ( i = 0; i < mpt->ngeoms; i++ )
+    {
+      if ( rtpoint_is_empty(ctx, mpt->geoms[i]) )
+        continue;
+      p = rt_getPoint2d_cp(ctx, mpt->geoms[i]->point, 0);
+      geographic_point_init(ctx, p->x, p->y, &((*points)[n++]));
+    }
+    return n;
+  }
+
+  return -1;
+}
+
+/**
+* Above this many vertex pairs, rtgeom_distance_spheroid indexes
+* its inputs rather than testing every pair of edges.
+*/
+#define CIRC_TREE_MIN_PAIRS 256
+
 /**
 * Calculate the distance between two RTGEOMs, using the coordinates are
 * longitude and latitude. Return immediately when the calulated distance drops
@@ -2098,6 +2339,7 @@ double rtgeom_distance_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
 {
   uint8_t type1, type2;
   int check_intersection = RT_FALSE;
+  int npoints1, npoints2;
   RTGBOX gbox1, gbox2;
 
   gbox_init(ctx, &gbox1);
@@ -2115,6 +2357,39 @@ double rtgeom_distance_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
     return -1.0;
   }
 
+  npoints1 = rtgeom_count_vertices(ctx, rtgeom1);
+  npoints2 = rtgeom_count_vertices(ctx, rtgeom2);
+
+  /* Points against points? Solve the closest pairs in one batch */
+  if ( ( rtgeom1->type == RTPOINTTYPE || rtgeom1->type == RTMULTIPOINTTYPE ) &&
+       ( rtgeom2->type == RTPOINTTYPE || rtgeom2->type == RTMULTIPOINTTYPE ) &&
+       ( npoints1 == 1 || npoints2 == 1 || (double)npoints1 * npoints2 <= CIRC_TREE_MIN_PAIRS ) )
+  {
+    GEOGRAPHIC_POINT *g1, *g2;
+    int n1 = rtgeom_geographic_points(ctx, rtgeom1, &g1);
+    int n2 = rtgeom_geographic_points(ctx, rtgeom2, &g2);
+    double distance = spheroid_distance_min(ctx, g1, n1, g2, n2, spheroid, tolerance, NULL, NULL);
+    rtfree(ctx, g1);
+    rtfree(ctx, g2);
+    return distance;
+  }
+
+  /* Many edge pairs to test? Index both sides and search the closest ones */
+  if ( (double)npoints1 * npoints2 > CIRC_TREE_MIN_PAIRS )
+  {
+    RTCIRCTREE *tree1 = rtgeom_circ_tree_create(ctx, rtgeom1);
+    RTCIRCTREE *tree2 = rtgeom_circ_tree_create(ctx, rtgeom2);
+    int indexed = (tree1->tree && tree2->tree);
+    double distance = 0.0;
+
+    if ( indexed )
+      distance = rtgeom_circ_tree_distance_spheroid(ctx, tree1, tree2, spheroid, tolerance);
+    rtgeom_circ_tree_destroy(ctx, tree1);
+    rtgeom_circ_tree_destroy(ctx, tree2);
+    if ( indexed )
+      return distance;
+  }
+
   type1 = rtgeom1->type;
   type2 = rtgeom2->type;
 
@@ -2282,7 +2557,9 @@ double rtgeom_distance_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
 
     for ( i = 0; i < col->ngeoms; i++ )
     {
-      double geom_distance = rtgeom_distance_spheroid(ctx, col->geoms[i], rtgeom2, spheroid, tolerance);
+      double geom_distance;
+      RT_ON_INTERRUPT(return -1.0);
+      geom_distance = rtgeom_distance_spheroid(ctx, col->geoms[i], rtgeom2, spheroid, tolerance);
       if ( geom_distance < distance )
         distance = geom_distance;
       if ( distance < tolerance )
@@ -2300,7 +2577,9 @@ double rtgeom_distance_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
 
     for ( i = 0; i < col->ngeoms; i++ )
     {
-      double geom_distance = rtgeom_distance_spheroid(ctx, rtgeom1, col->geoms[i], spheroid, tolerance);
+      double geom_distance;
+      RT_ON_INTERRUPT(return -1.0);
+      geom_distance = rtgeom_distance_spheroid(ctx, rtgeom1, col->geoms[i], spheroid, tolerance);
       if ( geom_distance < distance )
         distance = geom_distance;
       if ( distance < tolerance )
@@ -2315,6 +2594,79 @@ double rtgeom_distance_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
 
 }
 
+int rtgeom_dwithin_spheroid(const RTCTX *ctx, const RTGEOM *rtgeom1, const RTGEOM *rtgeom2, const SPHEROID *spheroid, double tolerance)
+{
+  RTGBOX gbox1, gbox2;
+  double distance, expand;
+
+  if ( rtgeom_is_empty(ctx, rtgeom1) || rtgeom_is_empty(ctx, rtgeom2) )
+    return RT_FALSE;
+
+  /* Make sure we have boxes */
+  if ( rtgeom1->bbox )
+    gbox1 = *(rtgeom1->bbox);
+  else
+    rtgeom_calculate_gbox_geodetic(ctx, rtgeom1, &gbox1);
+
+  if ( rtgeom2->bbox )
+    gbox2 = *(rtgeom2->bbox);
+  else
+    rtgeom_calculate_gbox_geodetic(ctx, rtgeom2, &gbox2);
+
+  /*
+  * Boxes are on the unit sphere, where chords are shorter than arcs,
+  * so growing one by the tolerance angle is enough. Leave room for
+  * the spheroid being smaller than the sphere in places.
+  */
+  expand = tolerance / spheroid->radius;
+  if ( spheroid->a != spheroid->b )
+    expand /= 0.95;
+  expand += FP_TOLERANCE;
+  gbox1.xmin -= expand;
+  gbox1.ymin -= expand;
+  gbox1.zmin -= expand;
+  gbox1.xmax += expand;
+  gbox1.ymax += expand;
+  gbox1.zmax += expand;
+  if ( ! gbox_overlaps(ctx, &gbox1, &gbox2) )
+    return RT_FALSE;
+
+  distance = rtgeom_distance_spheroid(ctx, rtgeom1, rtgeom2, spheroid, tolerance);
+  return ( distance >= 0.0 && distance <= tolerance ) ? RT_TRUE : RT_FALSE;
+}
+
+
+/**
+* Whether any polygon of rtgeom1 covers all the points, like the
+* recursion of rtgeom_covers_rtgeom_sphere would tell, but walking
+* the rings through a circle tree.
+*/
+static int rtgeom_covers_points_sphere_indexed(const RTCTX *ctx, const RTGEOM *rtgeom1, const RTCOLLECTION *mpoint)
+{
+  RTCIRCTREE *tree = rtgeom_circ_tree_create(ctx, rtgeom1);
+  RTPOINT2D pt_to_test;
+  int i, j, covers = RT_FALSE;
+
+  for ( i = 0; i < tree->npolys && ! covers; i++ )
+  {
+    covers = RT_TRUE;
+    for ( j = 0; j < mpoint->ngeoms; j++ )
+    {
+      const RTPOINT *pt = (RTPOINT*)mpoint->geoms[j];
+      if ( rtpoint_is_empty(ctx, pt) )
+        continue;
+      rt_getPoint2d_p(ctx, pt->point, 0, &pt_to_test);
+      if ( ! circ_poly_covers_point(ctx, &(tree->polys[i]), &pt_to_test) )
+      {
+        covers = RT_FALSE;
+        break;
+      }
+    }
+  }
+
+  rtgeom_circ_tree_destroy(ctx, tree);
+  return covers;
+}
 
 int rtgeom_covers_rtgeom_sphere(const RTCTX *ctx, const RTGEOM *rtgeom1, const RTGEOM *rtgeom2)
 {
@@ -2349,6 +2701,13 @@ int rtgeom_covers_rtgeom_sphere(const RTCTX *ctx, const RTGEOM *rtgeom1, const R
     rtgeom_calculate_gbox_geodetic(ctx, rtgeom2, &gbox2);
 
 
+  /* Many points against the same areas: index them once */
+  if ( (type1 == RTPOLYGONTYPE || type1 == RTMULTIPOLYGONTYPE) &&
+       type2 == RTMULTIPOINTTYPE && ((RTCOLLECTION*)rtgeom2)->ngeoms > 1 )
+  {
+    return rtgeom_covers_points_sphere_indexed(ctx, rtgeom1, (RTCOLLECTION*)rtgeom2);
+  }
+
   /* Handle the polygon/point case */
   if ( type1 == RTPOLYGONTYPE && type2 == RTPOINTTYPE )
   {
@@ -2489,12 +2848,120 @@ int rt_getPoint2d_p_ro(const RTCTX *ctx, const RTPOINTARRAY *pa, int n, RTPOINT2
   return RT_SUCCESS;
 }
 
+/**
+* Unit sphere coordinates of all the vertices of a point array,
+* with the same normalization as geographic_point_init.
+* Computed on first call and kept on the point array (the cache
+* is not part of its value, hence the const) until it is edited
+* or freed. Returns NULL for empty point arrays. Single-vertex
+* arrays are cached as well: the kernels handling single points
+* themselves (box, distance) convert them on the fly instead.
+* rtgeom_share builds it for the point arrays of shared geometries.
+*/
+const POINT3D* ptarray_geocentric_points(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  RTPOINTARRAY *cached = (RTPOINTARRAY*)pa;
+  POINT3D *pts;
+  GEOGRAPHIC_POINT g;
+  const RTPOINT2D *p;
+  int i;
+
+  if ( pa->npoints < 1 )
+    return NULL;
+
+  pts = RT_ATOMIC_LOAD_PTR(&cached->geocentric);
+  if ( pts )
+    return pts;
+
+  /* rtgeom_share builds it with the sharing context, readers never do */
+  assert( ! RTFLAGS_GET_SHARED(pa->flags) );
+
+  pts = rtalloc(ctx, sizeof(POINT3D) * pa->npoints);
+  for ( i = 0; i < pa->npoints; i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, i);
+    geographic_point_init(ctx, p->x, p->y, &g);
+    geog2cart(ctx, &g, &(pts[i]));
+  }
+
+  /* Published as the kernels load it, see RT_ATOMIC_PUBLISH */
+  if ( ! RT_ATOMIC_PUBLISH(&cached->geocentric, pts) )
+  {
+    rtfree(ctx, pts);
+    pts = RT_ATOMIC_LOAD_PTR(&cached->geocentric);
+  }
+  return pts;
+}
+
+/**
+* Edges whose end points are at least this close (cosine of the angle
+* between them) bulge out of the box of their end points by less than
+* 3e-8 of the sphere radius, see ptarray_calculate_gbox_geodetic_short.
+*/
+#define GBOX_GEODETIC_SHORT_EDGE_COS (1.0 - 1e-7)
+
+/**
+* Box of a ring or line made only of short edges, built from its
+* vertices without solving each edge for its extrema.
+*
+* Every point of an edge is a point of its chord, scaled up by at most
+* the secant of half the edge angle to reach the sphere. Scaling the
+* outward side of the vertex box by the secant of the longest edge
+* thus covers all the arcs. The result may be larger than the exact box
+* by that bulge, which is negligible for edges this short.
+*
+* @return RT_FALSE if some edge is too long, leaving gbox unchanged.
+*/
+static int
+ptarray_calculate_gbox_geodetic_short(const RTCTX *ctx, const POINT3D *pts, int npoints, RTGBOX *gbox)
+{
+  double xmin, xmax, ymin, ymax, zmin, zmax;
+  double min_cos = 1.0;
+  double secant;
+  int i;
+
+  xmin = xmax = pts[0].x;
+  ymin = ymax = pts[0].y;
+  zmin = zmax = pts[0].z;
+
+  for ( i = 1; i < npoints; i++ )
+  {
+    const POINT3D *q = &(pts[i]);
+    double c = dot_product(ctx, &(pts[i-1]), q);
+
+    if ( c < min_cos )
+    {
+      if ( c < GBOX_GEODETIC_SHORT_EDGE_COS )
+        return RT_FALSE;
+      min_cos = c;
+    }
+    if ( q->x < xmin ) xmin = q->x;
+    if ( q->x > xmax ) xmax = q->x;
+    if ( q->y < ymin ) ymin = q->y;
+    if ( q->y > ymax ) ymax = q->y;
+    if ( q->z < zmin ) zmin = q->z;
+    if ( q->z > zmax ) zmax = q->z;
+  }
+
+  /* sec(a/2) = 1 / sqrt((1 + cos(a)) / 2) */
+  secant = 1.0 / sqrt((1.0 + min_cos) / 2.0);
+
+  gbox->xmin = xmin < 0.0 ? FP_MAX(xmin * secant, -1.0) : xmin;
+  gbox->xmax = xmax > 0.0 ? FP_MIN(xmax * secant, 1.0) : xmax;
+  gbox->ymin = ymin < 0.0 ? FP_MAX(ymin * secant, -1.0) : ymin;
+  gbox->ymax = ymax > 0.0 ? FP_MIN(ymax * secant, 1.0) : ymax;
+  gbox->zmin = zmin < 0.0 ? FP_MAX(zmin * secant, -1.0) : zmin;
+  gbox->zmax = zmax > 0.0 ? FP_MIN(zmax * secant, 1.0) : zmax;
+  return RT_TRUE;
+}
+
 int ptarray_calculate_gbox_geodetic(const RTCTX *ctx, const RTPOINTARRAY *pa, RTGBOX *gbox)
 {
   int i;
   int first = RT_TRUE;
   const RTPOINT2D *p;
-  POINT3D A1, A2;
+  const POINT3D *pts;
+  POINT3D A1;
   RTGBOX edge_gbox;
 
   assert(gbox);
@@ -2515,16 +2982,15 @@ int ptarray_calculate_gbox_geodetic(const RTCTX *ctx, const RTPOINTARRAY *pa, RT
     return RT_SUCCESS;
   }
 
-  p = rt_getPoint2d_cp(ctx, pa, 0);
-  ll2cart(ctx, p, &A1);
+  pts = ptarray_geocentric_points(ctx, pa);
+
+  /* City scale geometries, no need to look inside the edges */
+  if ( ptarray_calculate_gbox_geodetic_short(ctx, pts, pa->npoints, gbox) )
+    return RT_SUCCESS;
 
   for ( i = 1; i < pa->npoints; i++ )
   {
-
-    p = rt_getPoint2d_cp(ctx, pa, i);
-    ll2cart(ctx, p, &A2);
-
-    edge_calculate_gbox(ctx, &A1, &A2, &edge_gbox);
+    edge_calculate_gbox(ctx, &(pts[i-1]), &(pts[i]), &edge_gbox);
 
     /* Initialize the box */
     if ( first )
@@ -2537,8 +3003,6 @@ int ptarray_calculate_gbox_geodetic(const RTCTX *ctx, const RTPOINTARRAY *pa, RT
     {
       gbox_merge(ctx, &edge_gbox, gbox);
     }
-
-    A1 = A2;
   }
 
   return RT_SUCCESS;
@@ -3221,7 +3685,7 @@ int ptarray_contains_point_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa, cons
 {
   POINT3D S1, S2; /* Stab line end points */
   POINT3D E1, E2; /* Edge end points (3-space) */
-  RTPOINT2D p; /* Edge end points (lon/lat) */
+  const POINT3D *pts;
   int count = 0, i, inter;
 
   /* Null input, not enough points for a ring? You ain't closed! */
@@ -3233,18 +3697,16 @@ int ptarray_contains_point_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa, cons
   ll2cart(ctx, pt_outside, &S2);
 
   /* Initialize first point */
-  rt_getPoint2d_p(ctx, pa, 0, &p);
-  ll2cart(ctx, &p, &E1);
+  pts = ptarray_geocentric_points(ctx, pa);
+  E1 = pts[0];
 
   /* Walk every edge and see if the stab line hits it */
   for ( i = 1; i < pa->npoints; i++ )
   {
     RTDEBUGF(ctx, 4, "testing edge (%d)", i);
-    RTDEBUGF(ctx, 4, "  start point == POINT(%.12g %.12g)", p.x, p.y);
 
     /* Read next point. */
-    rt_getPoint2d_p(ctx, pa, i, &p);
-    ll2cart(ctx, &p, &E2);
+    E2 = pts[i];
 
     /* Skip over too-short edges. */
     if ( point3d_equals(ctx, &E1, &E2) )
@@ -118,6 +118,7 @@ int edge_intersects(const RTCTX *ctx, const POINT3D *A1, const POINT3D *A2, cons
 double edge_distance_to_point(const RTCTX *ctx, const GEOGRAPHIC_EDGE *e, const GEOGRAPHIC_POINT *gp, GEOGRAPHIC_POINT *closest);
 double edge_distance_to_edge(const RTCTX *ctx, const GEOGRAPHIC_EDGE *e1, const GEOGRAPHIC_EDGE *e2, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2);
 void geographic_point_init(const RTCTX *ctx, double lon, double lat, GEOGRAPHIC_POINT *g);
+const POINT3D* ptarray_geocentric_points(const RTCTX *ctx, const RTPOINTARRAY *pa);
 int ptarray_contains_point_sphere(const RTCTX *ctx, const RTPOINTARRAY *pa, const RTPOINT2D *pt_outside, const RTPOINT2D *pt_to_test);
 int rtpoly_covers_point2d(const RTCTX *ctx, const RTPOLY *poly, const RTPOINT2D *pt_to_test);
 void rtpoly_pt_outside(const RTCTX *ctx, const RTPOLY *poly, RTPOINT2D *pt_outside);
@@ -144,6 +145,8 @@ void ll2cart(const RTCTX *ctx, const RTPOINT2D *g, POINT3D *p);
 */
 double spheroid_distance(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, const SPHEROID *spheroid);
 double spheroid_direction(const RTCTX *ctx, const GEOGRAPHIC_POINT *r, const GEOGRAPHIC_POINT *s, const SPHEROID *spheroid);
+void spheroid_distance_batch(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, int n, const SPHEROID *spheroid, double *distances);
+double spheroid_distance_min(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, int na, const GEOGRAPHIC_POINT *b, int nb, const SPHEROID *spheroid, double tolerance, int *ia, int *ib);
 int spheroid_project(const RTCTX *ctx, const GEOGRAPHIC_POINT *r, const SPHEROID *spheroid, double distance, double azimuth, GEOGRAPHIC_POINT *g);
 
 
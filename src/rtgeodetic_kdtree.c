@@ -0,0 +1,465 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+
+/* KD-trees over geographic points, for nearest neighbour searches */
+
+#include "rttopo_config.h"
+#include <float.h>
+
+#include "librttopo_geom_internal.h"
+#include "rtgeodetic.h"
+#include "rtgeom_log.h"
+
+/**
+* Maximum number of points in a leaf.
+*/
+#define KD_LEAF_SIZE 8
+
+/**
+* Node of the tree, covering points start to start+count-1 of
+* the tree arrays. Leaves have no children (left == -1).
+*/
+typedef struct
+{
+  double min[3];
+  double max[3];
+  int start;
+  int count;
+  int left;
+  int right;
+} KD_NODE;
+
+/**
+* The points are stored in tree order, both on the unit sphere
+* for the search and as geographic points for the distances.
+*/
+struct RTKDTREE
+{
+  int npoints;
+  POINT3D *pts;
+  GEOGRAPHIC_POINT *geo;
+  int *ids;           /* vertex index in the source point array */
+  int nnodes;
+  KD_NODE *nodes;
+};
+
+static double kd_coord(const POINT3D *p, int axis)
+{
+  return axis == 0 ? p->x : ( axis == 1 ? p->y : p->z );
+}
+
+static void kd_swap(RTKDTREE *tree, int i, int j)
+{
+  POINT3D p = tree->pts[i];
+  GEOGRAPHIC_POINT g = tree->geo[i];
+  int id = tree->ids[i];
+
+  tree->pts[i] = tree->pts[j];
+  tree->geo[i] = tree->geo[j];
+  tree->ids[i] = tree->ids[j];
+  tree->pts[j] = p;
+  tree->geo[j] = g;
+  tree->ids[j] = id;
+}
+
+/**
+* Reorder points lo to hi so that the one at position nth has
+* its final sorted position along axis (Hoare's selection).
+*/
+static void kd_select(RTKDTREE *tree, int lo, int hi, int nth, int axis)
+{
+  while ( lo < hi )
+  {
+    double pivot = kd_coord(&(tree->pts[(lo + hi) / 2]), axis);
+    int i = lo, j = hi;
+
+    while ( i <= j )
+    {
+      while ( kd_coord(&(tree->pts[i]), axis) < pivot ) i++;
+      while ( kd_coord(&(tree->pts[j]), axis) > pivot ) j--;
+      if ( i <= j )
+      {
+        kd_swap(tree, i, j);
+        i++;
+        j--;
+      }
+    }
+
+    if ( nth <= j )
+      hi = j;
+    else if ( nth >= i )
+      lo = i;
+    else
+      return;
+  }
+}
+
+static int kd_build(const RTCTX *ctx, RTKDTREE *tree, int start, int count)
+{
+  KD_NODE *node;
+  int n = tree->nnodes++;
+  int i, axis, half;
+  double extent;
+
+  node = &(tree->nodes[n]);
+  node->start = start;
+  node->count = count;
+  node->left = node->right = -1;
+  node->min[0] = node->max[0] = tree->pts[start].x;
+  node->min[1] = node->max[1] = tree->pts[start].y;
+  node->min[2] = node->max[2] = tree->pts[start].z;
+  for ( i = start + 1; i < start + count; i++ )
+  {
+    for ( axis = 0; axis < 3; axis++ )
+    {
+      double c = kd_coord(&(tree->pts[i]), axis);
+      if ( c < node->min[axis] ) node->min[axis] = c;
+      if ( c > node->max[axis] ) node->max[axis] = c;
+    }
+  }
+
+  if ( count <= KD_LEAF_SIZE )
+    return n;
+
+  /* Split at the median of the widest axis */
+  axis = 0;
+  extent = node->max[0] - node->min[0];
+  for ( i = 1; i < 3; i++ )
+  {
+    if ( node->max[i] - node->min[i] > extent )
+    {
+      extent = node->max[i] - node->min[i];
+      axis = i;
+    }
+  }
+  half = count / 2;
+  kd_select(tree, start, start + count - 1, start + half, axis);
+
+  /* Children go after the parent, node may have moved */
+  i = kd_build(ctx, tree, start, half);
+  tree->nodes[n].left = i;
+  i = kd_build(ctx, tree, start + half, count - half);
+  tree->nodes[n].right = i;
+  return n;
+}
+
+/**
+* Smallest angle between q and any unit vector inside the node box,
+* from the chord to the nearest point of the box.
+*/
+static double kd_node_angle(const KD_NODE *node, const POINT3D *q)
+{
+  double d2 = 0.0, chord;
+  int axis;
+
+  for ( axis = 0; axis < 3; axis++ )
+  {
+    double c = kd_coord(q, axis);
+    if ( c < node->min[axis] )
+      d2 += (node->min[axis] - c) * (node->min[axis] - c);
+    else if ( c > node->max[axis] )
+      d2 += (c - node->max[axis]) * (c - node->max[axis]);
+  }
+  chord = sqrt(d2);
+  return chord >= 2.0 ? M_PI : 2.0 * asin(chord / 2.0);
+}
+
+static double kd_point_angle(const POINT3D *p, const POINT3D *q)
+{
+  double chord = sqrt((p->x - q->x) * (p->x - q->x) +
+                      (p->y - q->y) * (p->y - q->y) +
+                      (p->z - q->z) * (p->z - q->z));
+  return chord >= 2.0 ? M_PI : 2.0 * asin(chord / 2.0);
+}
+
+RTKDTREE* ptarray_kd_tree_create(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  RTKDTREE *tree = rtalloc(ctx, sizeof(RTKDTREE));
+  const RTPOINT2D *p;
+  int i, n = pa ? pa->npoints : 0;
+
+  tree->npoints = n;
+  tree->nnodes = 0;
+  tree->pts = NULL;
+  tree->geo = NULL;
+  tree->ids = NULL;
+  tree->nodes = NULL;
+  if ( n < 1 )
+    return tree;
+
+  tree->pts = rtalloc(ctx, sizeof(POINT3D) * n);
+  tree->geo = rtalloc(ctx, sizeof(GEOGRAPHIC_POINT) * n);
+  tree->ids = rtalloc(ctx, sizeof(int) * n);
+  for ( i = 0; i < n; i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, i);
+    geographic_point_init(ctx, p->x, p->y, &(tree->geo[i]));
+    geog2cart(ctx, &(tree->geo[i]), &(tree->pts[i]));
+    tree->ids[i] = i;
+  }
+
+  /* A binary tree with leaves of at least half KD_LEAF_SIZE */
+  tree->nodes = rtalloc(ctx, sizeof(KD_NODE) * (4 * (n / KD_LEAF_SIZE) + 1));
+  kd_build(ctx, tree, 0, n);
+  return tree;
+}
+
+void rtkd_tree_destroy(const RTCTX *ctx, RTKDTREE *tree)
+{
+  if ( ! tree )
+    return;
+  if ( tree->pts ) rtfree(ctx, tree->pts);
+  if ( tree->geo ) rtfree(ctx, tree->geo);
+  if ( tree->ids ) rtfree(ctx, tree->ids);
+  if ( tree->nodes ) rtfree(ctx, tree->nodes);
+  rtfree(ctx, tree);
+}
+
+/**
+* A query on the tree: where from, on what spheroid, and what to
+* keep. Nearest searches keep the k best in a max-heap, radius
+* searches everything up to the radius in a growing list.
+*/
+typedef struct
+{
+  POINT3D q;
+  GEOGRAPHIC_POINT g;
+  const SPHEROID *s;
+  double scale;    /* spheroid length per radian, at the least */
+  int k;           /* 0 for radius searches */
+  double radius;
+  int n;
+  int max;
+  int *ids;
+  double *dists;
+} KD_QUERY;
+
+/** Current pruning distance: the worst kept, or the radius */
+static double kd_query_limit(const KD_QUERY *kq)
+{
+  if ( kq->k )
+    return kq->n < kq->k ? FLT_MAX : kq->dists[0];
+  return kq->radius;
+}
+
+static void kd_query_add(const RTCTX *ctx, KD_QUERY *kq, int id, double d)
+{
+  int i, parent, child;
+
+  if ( ! kq->k )
+  {
+    if ( d > kq->radius )
+      return;
+    if ( kq->n == kq->max )
+    {
+      kq->max *= 2;
+      kq->ids = rtrealloc(ctx, kq->ids, sizeof(int) * kq->max);
+      kq->dists = rtrealloc(ctx, kq->dists, sizeof(double) * kq->max);
+    }
+    kq->ids[kq->n] = id;
+    kq->dists[kq->n++] = d;
+    return;
+  }
+
+  if ( kq->n < kq->k )
+  {
+    /* Sift the newcomer up */
+    i = kq->n++;
+    while ( i > 0 && kq->dists[(parent = (i - 1) / 2)] < d )
+    {
+      kq->dists[i] = kq->dists[parent];
+      kq->ids[i] = kq->ids[parent];
+      i = parent;
+    }
+    kq->dists[i] = d;
+    kq->ids[i] = id;
+    return;
+  }
+
+  if ( d >= kq->dists[0] )
+    return;
+
+  /* Replace the worst and sift it down */
+  i = 0;
+  while ( (child = 2 * i + 1) < kq->n )
+  {
+    if ( child + 1 < kq->n && kq->dists[child + 1] > kq->dists[child] )
+      child++;
+    if ( kq->dists[child] <= d )
+      break;
+    kq->dists[i] = kq->dists[child];
+    kq->ids[i] = kq->ids[child];
+    i = child;
+  }
+  kq->dists[i] = d;
+  kq->ids[i] = id;
+}
+
+static void kd_search(const RTCTX *ctx, const RTKDTREE *tree, int n, KD_QUERY *kq)
+{
+  const KD_NODE *node = &(tree->nodes[n]);
+  GEOGRAPHIC_POINT cand[KD_LEAF_SIZE];
+  double dists[KD_LEAF_SIZE];
+  int ids[KD_LEAF_SIZE];
+  int i, ncand = 0;
+
+  if ( node->left < 0 )
+  {
+    /* Only solve the spheroid for the points that may qualify */
+    for ( i = node->start; i < node->start + node->count; i++ )
+    {
+      if ( kq->scale * kd_point_angle(&(tree->pts[i]), &(kq->q)) > kd_query_limit(kq) )
+        continue;
+      cand[ncand] = tree->geo[i];
+      ids[ncand++] = tree->ids[i];
+    }
+    if ( ncand )
+    {
+      spheroid_distance_batch(ctx, &(kq->g), cand, ncand, kq->s, dists);
+      for ( i = 0; i < ncand; i++ )
+        kd_query_add(ctx, kq, ids[i], dists[i]);
+    }
+    return;
+  }
+  else
+  {
+    double d1 = kq->scale * kd_node_angle(&(tree->nodes[node->left]), &(kq->q));
+    double d2 = kq->scale * kd_node_angle(&(tree->nodes[node->right]), &(kq->q));
+    int first = node->left, second = node->right;
+
+    /* Nearer side first, it tightens the limit for the other one */
+    if ( d2 < d1 )
+    {
+      double d = d1;
+      d1 = d2;
+      d2 = d;
+      first = node->right;
+      second = node->left;
+    }
+    if ( d1 <= kd_query_limit(kq) )
+      kd_search(ctx, tree, first, kq);
+    if ( d2 <= kd_query_limit(kq) )
+      kd_search(ctx, tree, second, kq);
+  }
+}
+
+static void kd_query_init(const RTCTX *ctx, KD_QUERY *kq, const RTPOINT2D *pt, const SPHEROID *s)
+{
+  geographic_point_init(ctx, pt->x, pt->y, &(kq->g));
+  geog2cart(ctx, &(kq->g), &(kq->q));
+  kq->s = s;
+  /*
+  * Along any path the spheroid length is at least the unit sphere angle
+  * times the smallest radius of curvature, b^2/a at the equator; keep a
+  * little slack for the rounding of the inverse solution.
+  */
+  kq->scale = (s->b * s->b / s->a) * (1.0 - 1e-9);
+  kq->n = 0;
+}
+
+static int kd_sort_cmp(const void *a, const void *b)
+{
+  const double *da = a, *db = b;
+  return *da < *db ? -1 : ( *da > *db ? 1 : 0 );
+}
+
+/* Sort results by distance, ids along */
+static void kd_query_sort(const RTCTX *ctx, KD_QUERY *kq, int *ids, double *dists)
+{
+  typedef struct { double d; int id; } KD_RESULT;
+  KD_RESULT *r;
+  int i;
+
+  if ( kq->n < 1 )
+    return;
+  r = rtalloc(ctx, sizeof(KD_RESULT) * kq->n);
+  for ( i = 0; i < kq->n; i++ )
+  {
+    r[i].d = kq->dists[i];
+    r[i].id = kq->ids[i];
+  }
+  qsort(r, kq->n, sizeof(KD_RESULT), kd_sort_cmp);
+  for ( i = 0; i < kq->n; i++ )
+  {
+    if ( ids ) ids[i] = r[i].id;
+    if ( dists ) dists[i] = r[i].d;
+  }
+  rtfree(ctx, r);
+}
+
+int rtkd_tree_nearest_spheroid(const RTCTX *ctx, const RTKDTREE *tree, const RTPOINT2D *pt, const SPHEROID *spheroid, int k, int *indexes, double *distances)
+{
+  KD_QUERY kq;
+
+  if ( ! tree || tree->npoints < 1 || k < 1 )
+    return 0;
+  if ( k > tree->npoints )
+    k = tree->npoints;
+
+  kd_query_init(ctx, &kq, pt, spheroid);
+  kq.k = k;
+  kq.max = k;
+  kq.ids = rtalloc(ctx, sizeof(int) * k);
+  kq.dists = rtalloc(ctx, sizeof(double) * k);
+
+  kd_search(ctx, tree, 0, &kq);
+  kd_query_sort(ctx, &kq, indexes, distances);
+
+  rtfree(ctx, kq.ids);
+  rtfree(ctx, kq.dists);
+  return kq.n;
+}
+
+int rtkd_tree_within_spheroid(const RTCTX *ctx, const RTKDTREE *tree, const RTPOINT2D *pt, const SPHEROID *spheroid, double distance, int **indexes, double **distances)
+{
+  KD_QUERY kq;
+
+  *indexes = NULL;
+  if ( distances )
+    *distances = NULL;
+  if ( ! tree || tree->npoints < 1 || distance < 0.0 )
+    return 0;
+
+  kd_query_init(ctx, &kq, pt, spheroid);
+  kq.k = 0;
+  kq.radius = distance;
+  kq.max = KD_LEAF_SIZE;
+  kq.ids = rtalloc(ctx, sizeof(int) * kq.max);
+  kq.dists = rtalloc(ctx, sizeof(double) * kq.max);
+
+  kd_search(ctx, tree, 0, &kq);
+  kd_query_sort(ctx, &kq, kq.ids, kq.dists);
+
+  if ( kq.n < 1 )
+  {
+    rtfree(ctx, kq.ids);
+    rtfree(ctx, kq.dists);
+    return 0;
+  }
+
+  *indexes = kq.ids;
+  if ( distances )
+    *distances = kq.dists;
+  else
+    rtfree(ctx, kq.dists);
+  return kq.n;
+}
@@ -0,0 +1,782 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+
+/* Spherical cap (circle) trees over geodetic edges */
+
+#include "rttopo_config.h"
+#include <float.h>
+
+#include "librttopo_geom_internal.h"
+#include "rtgeodetic_tree.h"
+#include "rtgeom_log.h"
+
+/**
+* Slack on cap radii when pruning, in radians. Larger than the
+* tolerance edge_intersects uses to decide sides, so that no edge
+* it would report as touching gets pruned.
+*/
+#define CIRC_NODE_EPSILON 1e-10
+
+static double circ_dot(const POINT3D *a, const POINT3D *b)
+{
+  return a->x * b->x + a->y * b->y + a->z * b->z;
+}
+
+/**
+* Angle between two unit vectors. Unlike acos of their dot
+* product, this stays accurate for nearly identical vectors.
+*/
+static double circ_angle(const POINT3D *a, const POINT3D *b)
+{
+  POINT3D n;
+  n.x = a->y * b->z - a->z * b->y;
+  n.y = a->z * b->x - a->x * b->z;
+  n.z = a->x * b->y - a->y * b->x;
+  return atan2(sqrt(n.x * n.x + n.y * n.y + n.z * n.z), circ_dot(a, b));
+}
+
+static int circ_point3d_equals(const POINT3D *p1, const POINT3D *p2)
+{
+  return FP_EQUALS(p1->x, p2->x) && FP_EQUALS(p1->y, p2->y) && FP_EQUALS(p1->z, p2->z);
+}
+
+/**
+* Lon/lat degrees to the unit sphere, normalizing coordinates
+* the same way the edge distance functions do.
+*/
+static void circ_ll2cart(const RTCTX *ctx, const RTPOINT2D *p, POINT3D *q)
+{
+  GEOGRAPHIC_POINT g;
+  geographic_point_init(ctx, p->x, p->y, &g);
+  geog2cart(ctx, &g, q);
+}
+
+static int circ_node_is_leaf(const CIRC_NODE *node)
+{
+  return (node->num_nodes == 0);
+}
+
+/**
+* Recurse from top of node tree and free all children.
+* does not free underlying point array.
+*/
+void circ_tree_free(const RTCTX *ctx, CIRC_NODE *node)
+{
+  int i;
+
+  for ( i = 0; i < node->num_nodes; i++ )
+    circ_tree_free(ctx, node->nodes[i]);
+  if ( node->nodes )
+    rtfree(ctx, node->nodes);
+  rtfree(ctx, node);
+}
+
+/**
+* Create a new leaf node, bounding the edge starting at vertex i.
+* Returns NULL for zero-length edges.
+*/
+static CIRC_NODE* circ_node_leaf_new(const RTCTX *ctx, const RTPOINTARRAY *pa, const POINT3D *pts, int i)
+{
+  CIRC_NODE *node;
+  POINT3D q1 = pts[i], q2 = pts[i+1], c;
+
+  /* Zero length edge, doesn't get a node */
+  if ( circ_point3d_equals(&q1, &q2) )
+    return NULL;
+
+  node = rtalloc(ctx, sizeof(CIRC_NODE));
+  node->p1 = rt_getPoint2d_cp(ctx, pa, i);
+  node->p2 = rt_getPoint2d_cp(ctx, pa, i+1);
+  node->q1 = q1;
+  node->q2 = q2;
+  node->num_nodes = 0;
+  node->nodes = NULL;
+
+  /* The arc midpoint, unless the edge is close to antipodal */
+  vector_sum(ctx, &q1, &q2, &c);
+  normalize(ctx, &c);
+  if ( c.x == 0.0 && c.y == 0.0 && c.z == 0.0 )
+    c = q1;
+  node->center = c;
+  node->radius = FP_MAX(circ_angle(&c, &q1), circ_angle(&c, &q2));
+
+  return node;
+}
+
+/**
+* Create a new leaf node, bounding the single vertex i.
+*/
+CIRC_NODE* circ_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
+{
+  CIRC_NODE *node = rtalloc(ctx, sizeof(CIRC_NODE));
+
+  node->p1 = node->p2 = rt_getPoint2d_cp(ctx, pa, i);
+  circ_ll2cart(ctx, node->p1, &(node->q1));
+  node->q2 = node->center = node->q1;
+  node->radius = 0.0;
+  node->num_nodes = 0;
+  node->nodes = NULL;
+  return node;
+}
+
+/**
+* Create a new internal node, bounding all of the given children.
+* The center is the normalized mean of the children centers,
+* which is not the tightest cap but is cheap and good enough
+* for runs of neighbouring edges.
+*/
+static CIRC_NODE* circ_node_internal_new(const RTCTX *ctx, CIRC_NODE **c, int num_nodes)
+{
+  CIRC_NODE *node = rtalloc(ctx, sizeof(CIRC_NODE));
+  POINT3D center;
+  double radius = 0.0;
+  int i;
+
+  center.x = center.y = center.z = 0.0;
+  for ( i = 0; i < num_nodes; i++ )
+    vector_sum(ctx, &center, &(c[i]->center), &center);
+  normalize(ctx, &center);
+  if ( center.x == 0.0 && center.y == 0.0 && center.z == 0.0 )
+    center = c[0]->center;
+
+  for ( i = 0; i < num_nodes; i++ )
+    radius = FP_MAX(radius, circ_angle(&center, &(c[i]->center)) + c[i]->radius);
+
+  node->center = center;
+  node->radius = FP_MIN(radius, M_PI);
+  node->num_nodes = num_nodes;
+  node->nodes = rtalloc(ctx, sizeof(CIRC_NODE*) * num_nodes);
+  memcpy(node->nodes, c, sizeof(CIRC_NODE*) * num_nodes);
+  node->p1 = node->p2 = NULL;
+  return node;
+}
+
+/**
+* Group a flat list of nodes, CIRC_NODE_SIZE at a time and level
+* by level, until a single root is left. The list is used as
+* scratch space. Returns NULL for an empty list.
+*/
+static CIRC_NODE* circ_tree_merge_nodes(const RTCTX *ctx, CIRC_NODE **nodes, int num_nodes)
+{
+  int num_parents, i, n;
+
+  if ( num_nodes < 1 )
+    return NULL;
+
+  while ( num_nodes > 1 )
+  {
+    num_parents = 0;
+    for ( i = 0; i < num_nodes; i += CIRC_NODE_SIZE )
+    {
+      n = FP_MIN(CIRC_NODE_SIZE, num_nodes - i);
+      /* The children are copied before their slot is reused */
+      if ( n == 1 )
+        nodes[num_parents++] = nodes[i];
+      else
+        nodes[num_parents++] = circ_node_internal_new(ctx, nodes + i, n);
+    }
+    num_nodes = num_parents;
+  }
+
+  return nodes[0];
+}
+
+/**
+* Build a tree of nodes from a point array, one leaf per non-zero
+* length edge. Consecutive edges are neighbours on the sphere, so
+* grouping them in order gives reasonably tight caps without sorting.
+* Returns NULL if the point array has no such edge.
+*/
+CIRC_NODE* circ_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  CIRC_NODE **nodes;
+  CIRC_NODE *node;
+  CIRC_NODE *tree;
+  const POINT3D *pts;
+  int i, j = 0;
+
+  if ( pa->npoints < 2 )
+    return NULL;
+
+  pts = ptarray_geocentric_points(ctx, pa);
+  nodes = rtalloc(ctx, sizeof(CIRC_NODE*) * (pa->npoints - 1));
+  for ( i = 0; i < pa->npoints - 1; i++ )
+  {
+    node = circ_node_leaf_new(ctx, pa, pts, i);
+    if ( node )
+      nodes[j++] = node;
+  }
+
+  tree = circ_tree_merge_nodes(ctx, nodes, j);
+  rtfree(ctx, nodes);
+  return tree;
+}
+
+
+/**
+* Stab line of a point in ring test, with its bounding cap and
+* the normal to its great circle (zero if degenerate).
+*/
+typedef struct
+{
+  POINT3D S1;
+  POINT3D S2;
+  POINT3D normal;
+  POINT3D center;
+  double radius;
+  int count;
+} CIRC_STAB;
+
+/**
+* Could the stab line interact with anything under the node?
+* The node cap must reach both the cap of the stab line and
+* the great circle the stab line lies on.
+*/
+static int circ_node_stab_may_touch(const CIRC_NODE *node, const CIRC_STAB *stab)
+{
+  double r = node->radius + CIRC_NODE_EPSILON;
+
+  if ( circ_angle(&(node->center), &(stab->center)) > r + stab->radius )
+    return RT_FALSE;
+
+  if ( r < M_PI_2 && fabs(circ_dot(&(node->center), &(stab->normal))) > sin(r) )
+    return RT_FALSE;
+
+  return RT_TRUE;
+}
+
+/**
+* Walk the edges of a ring tree that may cross the stab line,
+* counting crossings exactly like ptarray_contains_point_sphere.
+* Returns RT_TRUE as soon as the tested point is found on an edge.
+*/
+static int circ_node_stab(const RTCTX *ctx, const CIRC_NODE *node, CIRC_STAB *stab)
+{
+  int i, inter;
+
+  if ( ! circ_node_stab_may_touch(node, stab) )
+    return RT_FALSE;
+
+  if ( ! circ_node_is_leaf(node) )
+  {
+    for ( i = 0; i < node->num_nodes; i++ )
+    {
+      if ( circ_node_stab(ctx, node->nodes[i], stab) )
+        return RT_TRUE;
+    }
+    return RT_FALSE;
+  }
+
+  /* Our test point is on an edge end! Point is "in ring" by our definition */
+  if ( circ_point3d_equals(&(stab->S1), &(node->q1)) )
+    return RT_TRUE;
+
+  inter = edge_intersects(ctx, &(stab->S1), &(stab->S2), &(node->q1), &(node->q2));
+  if ( inter & PIR_INTERSECTS )
+  {
+    /* Stab line touching the edge, the point is on the ring */
+    if ( (inter & PIR_A_TOUCH_RIGHT) || (inter & PIR_A_TOUCH_LEFT) )
+      return RT_TRUE;
+
+    /* Disregard left-side touches and co-linear runs to avoid double counts */
+    if ( ! ( (inter & PIR_B_TOUCH_RIGHT) || (inter & PIR_COLINEAR) ) )
+      stab->count++;
+  }
+
+  return RT_FALSE;
+}
+
+/**
+* Indexed version of ptarray_contains_point_sphere: RT_TRUE if the
+* point is inside the ring or on its boundary, RT_FALSE otherwise.
+* Only the edges whose caps reach the stab line are tested.
+*/
+int circ_tree_ring_contains_point(const RTCTX *ctx, const CIRC_NODE *ring, const RTPOINT2D *pt_outside, const RTPOINT2D *pt_to_test)
+{
+  CIRC_STAB stab;
+
+  ll2cart(ctx, pt_to_test, &(stab.S1));
+  ll2cart(ctx, pt_outside, &(stab.S2));
+
+  vector_sum(ctx, &(stab.S1), &(stab.S2), &(stab.center));
+  normalize(ctx, &(stab.center));
+  if ( stab.center.x == 0.0 && stab.center.y == 0.0 && stab.center.z == 0.0 )
+  {
+    stab.center = stab.S1;
+    stab.radius = M_PI;
+  }
+  else
+  {
+    stab.radius = FP_MAX(circ_angle(&(stab.center), &(stab.S1)), circ_angle(&(stab.center), &(stab.S2)));
+  }
+
+  if ( circ_point3d_equals(&(stab.S1), &(stab.S2)) )
+    stab.normal.x = stab.normal.y = stab.normal.z = 0.0;
+  else
+    unit_normal(ctx, &(stab.S1), &(stab.S2), &(stab.normal));
+
+  stab.count = 0;
+  if ( circ_node_stab(ctx, ring, &stab) )
+    return RT_TRUE;
+
+  /* An odd number of crossings implies containment! */
+  return (stab.count % 2) ? RT_TRUE : RT_FALSE;
+}
+
+
+/**
+* Lower bound of the angular distance between anything in two nodes
+*/
+static double circ_node_min_distance(const CIRC_NODE *n1, const CIRC_NODE *n2)
+{
+  double d = circ_angle(&(n1->center), &(n2->center)) - n1->radius - n2->radius;
+  return d < 0.0 ? 0.0 : d;
+}
+
+static double circ_leaf_distance(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, GEOGRAPHIC_POINT *g1, GEOGRAPHIC_POINT *g2)
+{
+  GEOGRAPHIC_EDGE e1, e2;
+  int is_point1 = (n1->p1 == n1->p2);
+  int is_point2 = (n2->p1 == n2->p2);
+
+  geographic_point_init(ctx, n1->p1->x, n1->p1->y, &(e1.start));
+  geographic_point_init(ctx, n1->p2->x, n1->p2->y, &(e1.end));
+  geographic_point_init(ctx, n2->p1->x, n2->p1->y, &(e2.start));
+  geographic_point_init(ctx, n2->p2->x, n2->p2->y, &(e2.end));
+
+  if ( is_point1 && is_point2 )
+  {
+    *g1 = e1.start;
+    *g2 = e2.start;
+    return sphere_distance(ctx, &(e1.start), &(e2.start));
+  }
+  if ( is_point1 )
+  {
+    *g1 = e1.start;
+    return edge_distance_to_point(ctx, &e2, &(e1.start), g2);
+  }
+  if ( is_point2 )
+  {
+    *g2 = e2.start;
+    return edge_distance_to_point(ctx, &e1, &(e2.start), g1);
+  }
+
+  if ( edge_intersects(ctx, &(n1->q1), &(n1->q2), &(n2->q1), &(n2->q2)) )
+  {
+    *g1 = *g2 = e1.start;
+    return 0.0;
+  }
+  return edge_distance_to_edge(ctx, &e1, &e2, g1, g2);
+}
+
+/**
+* Branch and bound search of the closest pair of leaves, visiting
+* the children of the widest node nearest first and skipping the
+* ones that cannot beat the best distance found so far.
+* Stops as soon as that distance drops to the threshold.
+*/
+static void circ_tree_distance_tree_r(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, double threshold, double *min_dist, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2)
+{
+  const CIRC_NODE *split, *other;
+  const CIRC_NODE *child[CIRC_NODE_SIZE];
+  double bound[CIRC_NODE_SIZE];
+  GEOGRAPHIC_POINT g1, g2;
+  double d;
+  int i, j, swap;
+
+  if ( *min_dist <= threshold || circ_node_min_distance(n1, n2) > *min_dist )
+    return;
+
+  if ( circ_node_is_leaf(n1) && circ_node_is_leaf(n2) )
+  {
+    d = circ_leaf_distance(ctx, n1, n2, &g1, &g2);
+    if ( d < *min_dist )
+    {
+      *min_dist = d;
+      *closest1 = g1;
+      *closest2 = g2;
+    }
+    return;
+  }
+
+  swap = circ_node_is_leaf(n1) || ( ! circ_node_is_leaf(n2) && n2->radius > n1->radius );
+  split = swap ? n2 : n1;
+  other = swap ? n1 : n2;
+
+  /* Insertion sort of the children by distance bound */
+  for ( i = 0; i < split->num_nodes; i++ )
+  {
+    d = circ_node_min_distance(split->nodes[i], other);
+    for ( j = i; j > 0 && bound[j-1] > d; j-- )
+    {
+      bound[j] = bound[j-1];
+      child[j] = child[j-1];
+    }
+    bound[j] = d;
+    child[j] = split->nodes[i];
+  }
+
+  for ( i = 0; i < split->num_nodes; i++ )
+  {
+    if ( bound[i] > *min_dist )
+      break;
+    if ( swap )
+      circ_tree_distance_tree_r(ctx, other, child[i], threshold, min_dist, closest1, closest2);
+    else
+      circ_tree_distance_tree_r(ctx, child[i], other, threshold, min_dist, closest1, closest2);
+  }
+}
+
+/**
+* Angular distance between the contents of two trees, with the
+* closest points it was measured between. The search stops as soon
+* as a distance not greater than threshold (radians) is found.
+*/
+double circ_tree_distance_tree(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, double threshold, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2)
+{
+  double min_dist = DBL_MAX;
+  circ_tree_distance_tree_r(ctx, n1, n2, threshold, &min_dist, closest1, closest2);
+  return min_dist;
+}
+
+
+/**
+* Same as circ_poly_covers_point, with the point already on the
+* unit sphere as p.
+*/
+static int circ_poly_covers_point3d(const RTCTX *ctx, const CIRC_POLY *poly, const RTPOINT2D *pt, const POINT3D *p)
+{
+  int i, in_hole_count = 0;
+
+  if ( ! poly->rings[0] )
+    return RT_FALSE;
+
+  /* Point not in box? Done! */
+  if ( ! gbox_contains_point3d(ctx, &(poly->gbox), p) )
+    return RT_FALSE;
+
+  if ( ! circ_tree_ring_contains_point(ctx, poly->rings[0], &(poly->pt_outside), pt) )
+    return RT_FALSE;
+
+  /* Count up hole containment. Odd => outside boundary. */
+  for ( i = 1; i < poly->nrings; i++ )
+  {
+    if ( poly->rings[i] && circ_tree_ring_contains_point(ctx, poly->rings[i], &(poly->pt_outside), pt) )
+      in_hole_count++;
+  }
+
+  return (in_hole_count % 2) ? RT_FALSE : RT_TRUE;
+}
+
+/**
+* Indexed version of rtpoly_covers_point2d
+*/
+int circ_poly_covers_point(const RTCTX *ctx, const CIRC_POLY *poly, const RTPOINT2D *pt)
+{
+  GEOGRAPHIC_POINT gpt;
+  POINT3D p;
+
+  if ( ! poly->rings[0] )
+    return RT_FALSE;
+
+  geographic_point_init(ctx, pt->x, pt->y, &gpt);
+  geog2cart(ctx, &gpt, &p);
+  return circ_poly_covers_point3d(ctx, poly, pt, &p);
+}
+
+
+/**
+* Growable lists used while indexing a geometry
+*/
+typedef struct
+{
+  CIRC_NODE **nodes;
+  int nnodes, maxnodes;
+  CIRC_POLY *polys;
+  int npolys, maxpolys;
+  const RTPOINT2D **comps;
+  int ncomps, maxcomps;
+} CIRC_TREE_BUILDER;
+
+static void circ_tree_builder_add_node(const RTCTX *ctx, CIRC_TREE_BUILDER *b, CIRC_NODE *node)
+{
+  if ( b->nnodes == b->maxnodes )
+  {
+    b->maxnodes *= 2;
+    b->nodes = rtrealloc(ctx, b->nodes, sizeof(CIRC_NODE*) * b->maxnodes);
+  }
+  b->nodes[b->nnodes++] = node;
+}
+
+static void circ_tree_builder_add_comp(const RTCTX *ctx, CIRC_TREE_BUILDER *b, const RTPOINTARRAY *pa)
+{
+  if ( b->ncomps == b->maxcomps )
+  {
+    b->maxcomps *= 2;
+    b->comps = rtrealloc(ctx, b->comps, sizeof(RTPOINT2D*) * b->maxcomps);
+  }
+  b->comps[b->ncomps++] = rt_getPoint2d_cp(ctx, pa, 0);
+}
+
+/**
+* Index a linear point array: its edges, or its single location
+* if all its edges have zero length.
+*/
+static void circ_tree_builder_add_ptarray(const RTCTX *ctx, CIRC_TREE_BUILDER *b, const RTPOINTARRAY *pa)
+{
+  CIRC_NODE *node;
+
+  if ( pa->npoints < 1 )
+    return;
+
+  node = circ_tree_new(ctx, pa);
+  if ( ! node )
+    node = circ_node_point_new(ctx, pa, 0);
+  circ_tree_builder_add_node(ctx, b, node);
+  circ_tree_builder_add_comp(ctx, b, pa);
+}
+
+static void circ_tree_builder_add_poly(const RTCTX *ctx, CIRC_TREE_BUILDER *b, const RTPOLY *rtpoly)
+{
+  CIRC_POLY *poly;
+  CIRC_NODE *node;
+  int i;
+
+  if ( rtpoly->nrings < 1 || rtpoly->rings[0]->npoints < 1 )
+    return;
+
+  if ( b->npolys == b->maxpolys )
+  {
+    b->maxpolys *= 2;
+    b->polys = rtrealloc(ctx, b->polys, sizeof(CIRC_POLY) * b->maxpolys);
+  }
+  poly = &(b->polys[b->npolys++]);
+  poly->nrings = rtpoly->nrings;
+  poly->rings = rtalloc(ctx, sizeof(CIRC_NODE*) * rtpoly->nrings);
+
+  /* Same box and outside point as rtpoly_covers_point2d would use */
+  if ( rtpoly->bbox )
+    poly->gbox = *(rtpoly->bbox);
+  else
+    rtgeom_calculate_gbox_geodetic(ctx, (RTGEOM*)rtpoly, &(poly->gbox));
+  gbox_pt_outside(ctx, &(poly->gbox), &(poly->pt_outside));
+
+  for ( i = 0; i < rtpoly->nrings; i++ )
+  {
+    node = circ_tree_new(ctx, rtpoly->rings[i]);
+    if ( node )
+      circ_tree_builder_add_node(ctx, b, node);
+    /* Collapsed shell, index it as a point */
+    else if ( i == 0 )
+      circ_tree_builder_add_node(ctx, b, circ_node_point_new(ctx, rtpoly->rings[0], 0));
+    /* Not enough points for a ring? It contains nothing */
+    poly->rings[i] = rtpoly->rings[i]->npoints < 4 ? NULL : node;
+  }
+
+  circ_tree_builder_add_comp(ctx, b, rtpoly->rings[0]);
+}
+
+/**
+* Recursively index all components of a geometry.
+* Returns RT_FAILURE on the types rtgeom_distance_spheroid
+* does not handle either.
+*/
+static int circ_tree_builder_add_geom(const RTCTX *ctx, CIRC_TREE_BUILDER *b, const RTGEOM *geom)
+{
+  int i;
+
+  switch ( geom->type )
+  {
+    case RTPOINTTYPE:
+      circ_tree_builder_add_ptarray(ctx, b, ((RTPOINT*)geom)->point);
+      return RT_SUCCESS;
+    case RTLINETYPE:
+      circ_tree_builder_add_ptarray(ctx, b, ((RTLINE*)geom)->points);
+      return RT_SUCCESS;
+    case RTPOLYGONTYPE:
+      circ_tree_builder_add_poly(ctx, b, (RTPOLY*)geom);
+      return RT_SUCCESS;
+    case RTMULTIPOINTTYPE:
+    case RTMULTILINETYPE:
+    case RTMULTIPOLYGONTYPE:
+    case RTCOLLECTIONTYPE:
+    {
+      RTCOLLECTION *col = (RTCOLLECTION*)geom;
+      for ( i = 0; i < col->ngeoms; i++ )
+      {
+        if ( circ_tree_builder_add_geom(ctx, b, col->geoms[i]) == RT_FAILURE )
+          return RT_FAILURE;
+      }
+      return RT_SUCCESS;
+    }
+    default:
+      RTDEBUGF(ctx, 3, "circ_tree_builder_add_geom: cannot index %s", rttype_name(ctx, geom->type));
+      return RT_FAILURE;
+  }
+}
+
+RTCIRCTREE* rtgeom_circ_tree_create(const RTCTX *ctx, const RTGEOM *geom)
+{
+  CIRC_TREE_BUILDER b;
+  RTCIRCTREE *tree;
+  int i;
+
+  b.nnodes = b.npolys = b.ncomps = 0;
+  b.maxnodes = b.maxpolys = b.maxcomps = 8;
+  b.nodes = rtalloc(ctx, sizeof(CIRC_NODE*) * b.maxnodes);
+  b.polys = rtalloc(ctx, sizeof(CIRC_POLY) * b.maxpolys);
+  b.comps = rtalloc(ctx, sizeof(RTPOINT2D*) * b.maxcomps);
+
+  tree = rtalloc(ctx, sizeof(RTCIRCTREE));
+  tree->geom = geom;
+
+  if ( circ_tree_builder_add_geom(ctx, &b, geom) == RT_FAILURE )
+  {
+    /* Not indexable, distances will be computed the old way */
+    for ( i = 0; i < b.nnodes; i++ )
+      circ_tree_free(ctx, b.nodes[i]);
+    for ( i = 0; i < b.npolys; i++ )
+      rtfree(ctx, b.polys[i].rings);
+    b.nnodes = b.npolys = b.ncomps = 0;
+  }
+
+  tree->tree = circ_tree_merge_nodes(ctx, b.nodes, b.nnodes);
+  rtfree(ctx, b.nodes);
+
+  tree->npolys = b.npolys;
+  tree->polys = b.polys;
+  tree->ncomps = b.ncomps;
+  tree->comps = b.comps;
+
+  return tree;
+}
+
+void rtgeom_circ_tree_destroy(const RTCTX *ctx, RTCIRCTREE *tree)
+{
+  int i;
+
+  if ( tree->tree )
+    circ_tree_free(ctx, tree->tree);
+  for ( i = 0; i < tree->npolys; i++ )
+    rtfree(ctx, tree->polys[i].rings);
+  rtfree(ctx, tree->polys);
+  rtfree(ctx, tree->comps);
+  rtfree(ctx, tree);
+}
+
+int rtgeom_circ_tree_covers_point(const RTCTX *ctx, const RTCIRCTREE *tree, const RTPOINT2D *pt)
+{
+  int i;
+
+  for ( i = 0; i < tree->npolys; i++ )
+  {
+    if ( circ_poly_covers_point(ctx, &(tree->polys[i]), pt) )
+      return RT_TRUE;
+  }
+  return RT_FALSE;
+}
+
+int rtgeom_circ_tree_covers_points(const RTCTX *ctx, const RTCIRCTREE *tree, const RTPOINTARRAY *pa, int *covered)
+{
+  const POINT3D *pts;
+  const RTPOINT2D *pt;
+  int i, j, ncovered = 0;
+
+  if ( pa->npoints < 1 )
+    return 0;
+
+  /* Every point goes to the unit sphere once, whatever the number of polygons */
+  pts = ptarray_geocentric_points(ctx, pa);
+  for ( i = 0; i < pa->npoints; i++ )
+  {
+    pt = rt_getPoint2d_cp(ctx, pa, i);
+    covered[i] = RT_FALSE;
+    for ( j = 0; j < tree->npolys; j++ )
+    {
+      if ( circ_poly_covers_point3d(ctx, &(tree->polys[j]), pt, &(pts[i])) )
+      {
+        covered[i] = RT_TRUE;
+        ncovered++;
+        break;
+      }
+    }
+  }
+  return ncovered;
+}
+
+int rtgeom_covers_points_sphere(const RTCTX *ctx, const RTGEOM *geom, const RTPOINTARRAY *pa, int *covered)
+{
+  RTCIRCTREE *tree = rtgeom_circ_tree_create(ctx, geom);
+  int ncovered = rtgeom_circ_tree_covers_points(ctx, tree, pa, covered);
+  rtgeom_circ_tree_destroy(ctx, tree);
+  return ncovered;
+}
+
+/**
+* Is any component of one tree in an area of the other?
+*/
+static int circ_tree_geom_contains(const RTCTX *ctx, const RTCIRCTREE *t1, const RTCIRCTREE *t2)
+{
+  int i;
+
+  for ( i = 0; i < t2->ncomps; i++ )
+  {
+    if ( rtgeom_circ_tree_covers_point(ctx, t1, t2->comps[i]) )
+      return RT_TRUE;
+  }
+  return RT_FALSE;
+}
+
+double rtgeom_circ_tree_distance_spheroid(const RTCTX *ctx, const RTCIRCTREE *t1, const RTCIRCTREE *t2, const SPHEROID *s, double tolerance)
+{
+  GEOGRAPHIC_POINT g1, g2;
+  double distance, threshold;
+  int use_sphere = (s->a == s->b ? 1 : 0);
+
+  /* Empty or not indexable */
+  if ( ! t1->tree || ! t2->tree )
+  {
+    if ( rtgeom_is_empty(ctx, t1->geom) || rtgeom_is_empty(ctx, t2->geom) )
+      return -1.0;
+    return rtgeom_distance_spheroid(ctx, t1->geom, t2->geom, s, tolerance);
+  }
+
+  /* Point in polygon implies zero distance */
+  if ( circ_tree_geom_contains(ctx, t1, t2) || circ_tree_geom_contains(ctx, t2, t1) )
+    return 0.0;
+
+  /* On the spheroid, only stop early well below the tolerance */
+  threshold = tolerance / s->radius;
+  if ( ! use_sphere )
+    threshold *= 0.95;
+
+  distance = circ_tree_distance_tree(ctx, t1->tree, t2->tree, threshold, &g1, &g2);
+
+  /* Sphere special case, axes equal */
+  if ( use_sphere || distance == 0.0 )
+    return s->radius * distance;
+  /* Below tolerance, actual distance isn't of interest */
+  if ( distance <= threshold )
+    return s->radius * distance;
+  /* Close or greater than tolerance, get the real answer based on closest approach */
+  return spheroid_distance(ctx, &g1, &g2, s);
+}
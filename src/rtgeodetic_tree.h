@@ -0,0 +1,91 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+#ifndef _RTGEODETIC_TREE_H
+#define _RTGEODETIC_TREE_H 1
+
+#include "rtgeodetic.h"
+
+/**
+* Maximum number of children of an internal node.
+*/
+#define CIRC_NODE_SIZE 8
+
+/**
+* Note that p1 and p2 are pointers into an independent RTPOINTARRAY,
+* do not free them.
+*
+* Every node is bounded by a spherical cap, given by its center on
+* the unit sphere and its angular radius. Leaves bound a single edge,
+* or a single location when p1 == p2.
+*/
+typedef struct circ_node
+{
+  POINT3D center;
+  double radius;
+  int num_nodes;
+  struct circ_node **nodes;
+  const RTPOINT2D *p1;
+  const RTPOINT2D *p2;
+  POINT3D q1; /* p1 and p2 on the unit sphere */
+  POINT3D q2;
+} CIRC_NODE;
+
+void circ_tree_free(const RTCTX *ctx, CIRC_NODE *node);
+CIRC_NODE* circ_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa);
+CIRC_NODE* circ_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i);
+int circ_tree_ring_contains_point(const RTCTX *ctx, const CIRC_NODE *ring, const RTPOINT2D *pt_outside, const RTPOINT2D *pt_to_test);
+double circ_tree_distance_tree(const RTCTX *ctx, const CIRC_NODE *n1, const CIRC_NODE *n2, double threshold, GEOGRAPHIC_POINT *closest1, GEOGRAPHIC_POINT *closest2);
+
+/**
+* The ring trees of an areal component, shell first, along with
+* the box and outside point used to test points against it.
+* A NULL ring stands for one that cannot contain anything
+* (fewer than four points or collapsed).
+*/
+typedef struct
+{
+  int nrings;
+  CIRC_NODE **rings;
+  RTGBOX gbox;
+  RTPOINT2D pt_outside;
+} CIRC_POLY;
+
+/**
+* Indexed representation of a whole geodetic geometry, the
+* spherical counterpart of RTRECTTREE.
+*
+* Nodes point into the point arrays of the source geometry,
+* which must then outlive the tree.
+*/
+struct RTCIRCTREE
+{
+  const RTGEOM *geom;     /* source geometry */
+  CIRC_NODE *tree;        /* NULL if empty or not indexable */
+  int npolys;
+  CIRC_POLY *polys;
+  int ncomps;
+  const RTPOINT2D **comps; /* first vertex of each component */
+};
+
+int circ_poly_covers_point(const RTCTX *ctx, const CIRC_POLY *poly, const RTPOINT2D *pt);
+
+#endif /* _RTGEODETIC_TREE_H */
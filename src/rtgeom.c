@@ -30,6 +30,7 @@
 #include <stdarg.h>
 
 #include "librttopo_geom_internal.h"
+#include "rtgeodetic.h"
 #include "rtgeom_log.h"
 
 
@@ -600,7 +601,11 @@ rtpoint_inside_circle(const RTCTX *ctx, const RTPOINT *p, double cx, double cy,
 void
 rtgeom_drop_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
 {
-  if ( rtgeom->bbox ) rtfree(ctx, rtgeom->bbox);
+  if ( rtgeom->bbox )
+  {
+    rtfree(ctx, rtgeom->bbox);
+    ((RTCTX *)ctx)->bbox_stats.drops++;
+  }
   rtgeom->bbox = NULL;
   RTFLAGS_SET_BBOX(rtgeom->flags, 0);
 }
@@ -616,7 +621,12 @@ rtgeom_add_bbox(const RTCTX *ctx, RTGEOM *rtgeom)
   /* an empty RTGEOM has no bbox */
   if ( rtgeom_is_empty(ctx, rtgeom) ) return;
 
-  if ( rtgeom->bbox ) return;
+  if ( rtgeom->bbox )
+  {
+    ((RTCTX *)ctx)->bbox_stats.hits++;
+    return;
+  }
+  ((RTCTX *)ctx)->bbox_stats.misses++;
   RTFLAGS_SET_BBOX(rtgeom->flags, 1);
   rtgeom->bbox = gbox_new(ctx, rtgeom->flags);
   rtgeom_calculate_gbox(ctx, rtgeom, rtgeom->bbox);
@@ -659,6 +669,28 @@ rtgeom_get_bbox(const RTCTX *ctx, const RTGEOM *rtg)
   return rtg->bbox;
 }
 
+int
+rtgeom_get_bbox_cartesian(const RTCTX *ctx, const RTGEOM *rtg, RTGBOX *gbox)
+{
+  const RTGBOX *box;
+
+  /* The cached box of geodetic geometries is geocentric */
+  if ( RTFLAGS_GET_GEODETIC(rtg->flags) )
+    return rtgeom_calculate_gbox_cartesian(ctx, rtg, gbox);
+
+  box = rtgeom_get_bbox(ctx, rtg);
+  if ( ! box )
+    return RT_FAILURE;
+  *gbox = *box;
+  return RT_SUCCESS;
+}
+
+void
+rtgeom_bbox_stats(const RTCTX *ctx, RTBBOXSTATS *stats)
+{
+  *stats = ctx->bbox_stats;
+}
+
 
 /**
 * Calculate the gbox for this goemetry, a cartesian box or
@@ -917,6 +949,10 @@ void
 rtgeom_longitude_shift(const RTCTX *ctx, RTGEOM *rtgeom)
 {
   int i;
+
+  /* Recompute bbox on next request */
+  rtgeom_drop_bbox(ctx, rtgeom);
+
   switch (rtgeom->type)
   {
     RTPOINT *point;
@@ -1115,6 +1151,142 @@ void rtgeom_free(const RTCTX *ctx, RTGEOM *rtgeom)
   return;
 }
 
+/**
+* A geometry with several owners, see rtgeom_share.
+*/
+struct RTSHAREDGEOM
+{
+  RTGEOM *geom;
+  const RTCTX *owner; /* context freeing geom */
+  long refcount;
+};
+
+/**
+* Compute the boxes of a geometry and all of its parts, which
+* rtgeom_get_bbox would otherwise add on first use.
+*/
+static void
+rtgeom_add_bbox_all(const RTCTX *ctx, RTGEOM *geom)
+{
+  int i;
+
+  rtgeom_add_bbox(ctx, geom);
+  if ( rtgeom_is_collection(ctx, geom) )
+  {
+    RTCOLLECTION *col = (RTCOLLECTION *)geom;
+    for ( i = 0; i < col->ngeoms; i++ )
+      rtgeom_add_bbox_all(ctx, col->geoms[i]);
+  }
+}
+
+/**
+* Build the unit sphere coordinates of a point array with the
+* sharing context, and flag it so that readers, whose contexts
+* may not free what they allocated on it, never build caches.
+*/
+static void
+ptarray_share(const RTCTX *ctx, RTPOINTARRAY *pa)
+{
+  ptarray_geocentric_points(ctx, pa);
+  RTFLAGS_SET_SHARED(pa->flags, 1);
+}
+
+static void
+rtgeom_share_ptarrays(const RTCTX *ctx, RTGEOM *geom)
+{
+  int type = geom->type;
+  int i;
+
+  switch(type)
+  {
+    /* Take advantage of fact tht pt/ln/circ/tri have same memory structure */
+    case RTPOINTTYPE:
+    case RTLINETYPE:
+    case RTCIRCSTRINGTYPE:
+    case RTTRIANGLETYPE:
+    {
+      RTLINE *l = (RTLINE*)geom;
+      ptarray_share(ctx, l->points);
+      break;
+    }
+    case RTPOLYGONTYPE:
+    {
+      RTPOLY *p = (RTPOLY*)geom;
+      for( i = 0; i < p->nrings; i++ )
+        ptarray_share(ctx, p->rings[i]);
+      break;
+    }
+    case RTCURVEPOLYTYPE:
+    {
+      RTCURVEPOLY *c = (RTCURVEPOLY*)geom;
+      for( i = 0; i < c->nrings; i++ )
+        rtgeom_share_ptarrays(ctx, c->rings[i]);
+      break;
+    }
+    default:
+    {
+      if( rtgeom_is_collection(ctx, geom) )
+      {
+        RTCOLLECTION *c = (RTCOLLECTION*)geom;
+        for( i = 0; i < c->ngeoms; i++ )
+          rtgeom_share_ptarrays(ctx, c->geoms[i]);
+      }
+      else
+      {
+        rterror(ctx, "rtgeom_share: unable to handle type '%s'", rttype_name(ctx, type));
+      }
+    }
+  }
+}
+
+RTSHAREDGEOM *
+rtgeom_share(const RTCTX *ctx, RTGEOM *geom)
+{
+  RTSHAREDGEOM *shared;
+
+  if ( ! geom )
+  {
+    rterror(ctx, "rtgeom_share: null input");
+    return NULL;
+  }
+
+  /* Nothing is to be written to the geometry once shared */
+  rtgeom_add_bbox_all(ctx, geom);
+  rtgeom_share_ptarrays(ctx, geom);
+
+  shared = rtalloc(ctx, sizeof(RTSHAREDGEOM));
+  shared->geom = geom;
+  shared->owner = ctx;
+  shared->refcount = 1;
+  return shared;
+}
+
+RTSHAREDGEOM *
+rtgeom_shared_retain(const RTCTX *ctx, RTSHAREDGEOM *shared)
+{
+  RT_ATOMIC_INC(&shared->refcount);
+  return shared;
+}
+
+void
+rtgeom_shared_release(const RTCTX *ctx, RTSHAREDGEOM *shared)
+{
+  const RTCTX *owner;
+
+  if ( ! shared ) return;
+  if ( RT_ATOMIC_DEC(&shared->refcount) > 0 ) return;
+
+  owner = shared->owner;
+  rtgeom_free(owner, shared->geom);
+  rtfree(owner, shared);
+}
+
+const RTGEOM *
+rtgeom_shared_geom(const RTCTX *ctx, const RTSHAREDGEOM *shared)
+{
+  return shared->geom;
+}
+
 int rtgeom_needs_bbox(const RTCTX *ctx, const RTGEOM *geom)
 {
   assert(geom);
@@ -1751,6 +1923,8 @@ rtgeom_affine(const RTCTX *ctx, RTGEOM *geom, const RTAFFINE *affine)
     }
   }
 
+  /* Recompute bbox on next request */
+  rtgeom_drop_bbox(ctx, geom);
 }
 
 void
@@ -1802,20 +1976,8 @@ rtgeom_scale(const RTCTX *ctx, RTGEOM *geom, const RTPOINT4D *factor)
     }
   }
 
-  /* Recompute bbox if needed */
-
-  if ( geom->bbox )
-  {
-    /* TODO: expose a gbox_scale function */
-    geom->bbox->xmin *= factor->x;
-    geom->bbox->xmax *= factor->x;
-    geom->bbox->ymin *= factor->y;
-    geom->bbox->ymax *= factor->y;
-    geom->bbox->zmin *= factor->z;
-    geom->bbox->zmax *= factor->z;
-    geom->bbox->mmin *= factor->m;
-    geom->bbox->mmax *= factor->m;
-  }
+  /* Recompute bbox on next request, negative factors swap its bounds */
+  rtgeom_drop_bbox(ctx, geom);
 }
 
 RTGEOM*
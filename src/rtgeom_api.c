@@ -553,6 +553,8 @@ ptarray_set_point4d(const RTCTX *ctx, RTPOINTARRAY *pa, int n, const RTPOINT4D *
 {
   uint8_t *ptr;
   assert(n >= 0 && n < pa->npoints);
+  ptarray_make_writable(ctx, pa);
+  ptarray_caches_clear(ctx, pa);
   ptr=rt_getPoint_internal(ctx, pa, n);
   switch ( RTFLAGS_GET_ZM(pa->flags) )
   {
@@ -835,20 +837,24 @@ interpolate_point4d(const RTCTX *ctx, RTPOINT4D *A, RTPOINT4D *B, RTPOINT4D *I,
 }
 
 
-int _rtgeom_interrupt_requested = 0;
 void
 rtgeom_request_interrupt(const RTCTX *ctx) {
-  _rtgeom_interrupt_requested = 1;
+  ((RTCTX *)ctx)->interrupt_requested = 1;
 }
 void
 rtgeom_cancel_interrupt(const RTCTX *ctx) {
-  _rtgeom_interrupt_requested = 0;
+  ((RTCTX *)ctx)->interrupt_requested = 0;
 }
 
-rtinterrupt_callback *_rtgeom_interrupt_callback = 0;
 rtinterrupt_callback *
 rtgeom_register_interrupt_callback(const RTCTX *ctx, rtinterrupt_callback *cb) {
-  rtinterrupt_callback *old = _rtgeom_interrupt_callback;
-  _rtgeom_interrupt_callback = cb;
+  rtinterrupt_callback *old = ctx->interrupt_callback;
+  ((RTCTX *)ctx)->interrupt_callback = cb;
   return old;
 }
+
+void
+rtgeom_set_interrupt_callback(RTCTX *ctx, rtinterrupt_callback_r *cb, void *arg) {
+  ctx->interrupt_callback_r = cb;
+  ctx->interrupt_callback_arg = arg;
+}
@@ -5009,6 +5009,13 @@ rtt_GetFaceByPoint(RTT_TOPOLOGY *topo, RTPOINT *pt, double tol)
     RTDEBUGF(iface->ctx, 1, "Distance from edge %" RTTFMT_ELEMID
                 " is %g (tol=%g)", e->edge_id, dist, tol);
 
+    /* interrupted */
+    if ( dist < 0 )
+    {
+      rtt_release_edges(iface->ctx, elem, num);
+      return -1;
+    }
+
     /* we won't consider edges too far */
     if ( dist > tol ) continue;
     if ( e->face_left == 0 ) {
@@ -5132,6 +5139,13 @@ _rtt_AddPoint(RTT_TOPOLOGY* topo, RTPOINT* point, double tol, int findFace)
         sorted[i].score = rtgeom_mindistance2d(iface->ctx, rtpoint_as_rtgeom(iface->ctx, nodes[i].geom), pt);
         RTDEBUGF(iface->ctx, 1, "Node %" RTTFMT_ELEMID " distance: %.15g",
           ((RTT_ISO_NODE*)(sorted[i].ptr))->node_id, sorted[i].score);
+        /* interrupted */
+        if ( sorted[i].score < 0 )
+        {
+          rtfree(iface->ctx, sorted);
+          _rtt_release_nodes(iface->ctx, nodes, num);
+          return -1;
+        }
       }
       qsort(sorted, num, sizeof(scored_pointer), compare_scored_pointer);
       nodes2 = rtalloc(iface->ctx, sizeof(RTT_ISO_NODE)*num);
@@ -5149,6 +5163,12 @@ _rtt_AddPoint(RTT_TOPOLOGY* topo, RTPOINT* point, double tol, int findFace)
       RTT_ISO_NODE *n = &(nodes[i]);
       RTGEOM *g = rtpoint_as_rtgeom(iface->ctx, n->geom);
       double dist = rtgeom_mindistance2d(iface->ctx, g, pt);
+      /* interrupted */
+      if ( dist < 0 )
+      {
+        _rtt_release_nodes(iface->ctx, nodes, num);
+        return -1;
+      }
       /* TODO: move this check in the previous sort scan ... */
       /* must be closer than tolerated, unless distance is zero */
       if ( dist && dist >= tol ) continue;
@@ -5195,6 +5215,13 @@ _rtt_AddPoint(RTT_TOPOLOGY* topo, RTPOINT* point, double tol, int findFace)
       sorted[i].score = rtgeom_mindistance2d(iface->ctx, rtline_as_rtgeom(iface->ctx, edges[i].geom), pt);
       RTDEBUGF(iface->ctx, 1, "Edge %" RTTFMT_ELEMID " distance: %.15g",
         ((RTT_ISO_EDGE*)(sorted[i].ptr))->edge_id, sorted[i].score);
+      /* interrupted */
+      if ( sorted[i].score < 0 )
+      {
+        rtfree(iface->ctx, sorted);
+        rtt_release_edges(iface->ctx, edges, num);
+        return -1;
+      }
     }
     qsort(sorted, num, sizeof(scored_pointer), compare_scored_pointer);
     edges2 = rtalloc(iface->ctx, sizeof(RTT_ISO_EDGE)*num);
@@ -5229,6 +5256,12 @@ _rtt_AddPoint(RTT_TOPOLOGY* topo, RTPOINT* point, double tol, int findFace)
 
     /* project point to line, split edge by point */
     prj = rtgeom_closest_point(iface->ctx, g, pt);
+    if ( ! prj )
+    {
+      /* interrupted */
+      rtt_release_edges(iface->ctx, edges, num);
+      return -1;
+    }
     if ( rtgeom_has_z(iface->ctx, pt) )
     {{
       /*
@@ -5715,6 +5748,7 @@ _rtt_AddLine(RTT_TOPOLOGY* topo, RTLINE* line, double tol, int* nedges,
              int handleFaceSplit)
 {
   const RTT_BE_IFACE *iface = topo->be_iface;
+  const RTCTX *ctx = iface->ctx;
   RTGEOM *geomsbuf[1];
   RTGEOM **geoms;
   int ngeoms;
@@ -5774,6 +5808,14 @@ _rtt_AddLine(RTT_TOPOLOGY* topo, RTLINE* line, double tol, int* nedges,
       RTT_ISO_EDGE *e = &(edges[i]);
       RTGEOM *g = rtline_as_rtgeom(iface->ctx, e->geom);
       double dist = rtgeom_mindistance2d(iface->ctx, g, noded);
+      /* interrupted */
+      if ( dist < 0 )
+      {
+        rtfree(iface->ctx, nearby);
+        rtt_release_edges(iface->ctx, edges, num);
+        rtgeom_free(iface->ctx, noded);
+        return NULL;
+      }
       /* must be closer than tolerated, unless distance is zero */
       if ( dist && dist >= tol ) continue;
       nearby[nn++] = g;
@@ -5848,6 +5890,14 @@ _rtt_AddLine(RTT_TOPOLOGY* topo, RTLINE* line, double tol, int* nedges,
       RTT_ISO_NODE *n = &(nodes[i]);
       RTGEOM *g = rtpoint_as_rtgeom(iface->ctx, n->geom);
       double dist = rtgeom_mindistance2d(iface->ctx, g, noded);
+      /* interrupted */
+      if ( dist < 0 )
+      {
+        rtfree(iface->ctx, nearby);
+        _rtt_release_nodes(iface->ctx, nodes, num);
+        rtgeom_free(iface->ctx, noded);
+        return NULL;
+      }
       /* must be closer than tolerated, unless distance is zero */
       if ( dist && dist >= tol ) continue;
       nearby[nn++] = g;
@@ -5927,6 +5977,13 @@ _rtt_AddLine(RTT_TOPOLOGY* topo, RTLINE* line, double tol, int* nedges,
   {
     RTT_ELEMID id;
     RTGEOM *g = geoms[i];
+
+    RT_ON_INTERRUPT(
+      rtgeom_free(iface->ctx, noded);
+      rtfree(iface->ctx, ids);
+      return NULL
+    );
+
     g->srid = noded->srid;
 
 #if RTGEOM_DEBUG_LEVEL > 0
@@ -6022,6 +6079,7 @@ RTT_ELEMID*
 rtt_AddPolygon(RTT_TOPOLOGY* topo, RTPOLY* poly, double tol, int* nfaces)
 {
   const RTT_BE_IFACE *iface = topo->be_iface;
+  const RTCTX *ctx = iface->ctx;
   int i;
   *nfaces = -1; /* error condition, by default */
   int num;
@@ -6044,12 +6102,16 @@ rtt_AddPolygon(RTT_TOPOLOGY* topo, RTPOLY* poly, double tol, int* nfaces)
     RTT_ELEMID *eids;
     int nedges;
 
+    RT_ON_INTERRUPT(return NULL);
+
     pa = ptarray_clone(iface->ctx, poly->rings[i]);
     line = rtline_construct(iface->ctx, topo->srid, NULL, pa);
+    ((RTCTX *)ctx)->interrupted = 0;
     eids = rtt_AddLine( topo, line, tol, &nedges );
     if ( nedges < 0 ) {
-      /* probably too late as rtt_AddLine invoked rterror */
       rtline_free(iface->ctx, line);
+      if ( ctx->interrupted ) return NULL;
+      /* probably too late as rtt_AddLine invoked rterror */
       rterror(iface->ctx, "Error adding ring %d of polygon", i);
       return NULL;
     }
@@ -6091,6 +6153,14 @@ rtt_AddPolygon(RTT_TOPOLOGY* topo, RTPOLY* poly, double tol, int* nfaces)
       GEOSGeometry *fgg, *sp;
       int covers;
 
+      RT_ON_INTERRUPT(
+        GEOSPreparedGeom_destroy_r(iface->ctx->gctx, ppoly);
+        GEOSGeom_destroy_r(iface->ctx->gctx, polyg);
+        rtfree(iface->ctx, ids);
+        _rtt_release_faces(iface->ctx, faces, nfacesinbox);
+        return NULL
+      );
+
       /* check if a point on this face surface is covered by our polygon */
       fg = rtt_GetFaceGeometry( topo, f->face_id );
       if ( ! fg )
@@ -6959,6 +7029,7 @@ rtt_Polygonize(RTT_TOPOLOGY* topo)
   RTT_EDGERING_ARRAY holes, shells;
   int i;
   int err = 0;
+  int interrupted = 0;
   const RTCTX *ctx = iface->ctx;
 
   _rtt_EnsureGeos(iface->ctx);
@@ -7000,6 +7071,8 @@ rtt_Polygonize(RTT_TOPOLOGY* topo)
   i = 0;
   while (1)
   {
+    RT_ON_INTERRUPT(interrupted = 1; break);
+
     i = _rtt_FetchNextUnvisitedEdge(topo, &edgetable, i);
     if ( i < 0 ) break; /* end of unvisited */
     edge = &(edgetable.edges[i]);
@@ -7028,6 +7101,14 @@ rtt_Polygonize(RTT_TOPOLOGY* topo)
     }
   }
 
+  if ( interrupted )
+  {
+      rtt_release_edges(ctx, edgetable.edges, edgetable.size);
+      RTT_EDGERING_ARRAY_CLEAN( ctx, &holes );
+      RTT_EDGERING_ARRAY_CLEAN( ctx, &shells );
+      return -1;
+  }
+
   if ( err )
   {
       rtt_release_edges(ctx, edgetable.edges, edgetable.size);
@@ -7048,6 +7129,13 @@ rtt_Polygonize(RTT_TOPOLOGY* topo)
     RTT_ELEMID containing_face;
     RTT_EDGERING *ring = holes.rings[i];
 
+    RT_ON_INTERRUPT(
+      rtt_release_edges(ctx, edgetable.edges, edgetable.size);
+      RTT_EDGERING_ARRAY_CLEAN( ctx, &holes );
+      RTT_EDGERING_ARRAY_CLEAN( ctx, &shells );
+      return -1
+    );
+
     containing_face = _rtt_FindFaceContainingRing(topo, ring, &shells);
     RTDEBUGF(ctx, 1, "Ring %d contained by face %" RTTFMT_ELEMID, i, containing_face);
     if ( containing_face == -1 )
@@ -45,6 +45,7 @@ typedef struct
   int has_m; /* M? */
   int has_srid; /* SRID? */
   const uint8_t *pos; /* Current parse position */
+  int reference; /* Reference coordinates in place when possible? */
 } wkb_parse_state;
 
 
@@ -322,6 +323,15 @@ static double double_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s)
   return d;
 }
 
+/**
+* Can the native coordinates at the current position be referenced
+* in place rather than copied? They must be aligned for direct access.
+*/
+static inline int wkb_parse_state_can_reference(const wkb_parse_state *s)
+{
+  return s->reference && ((uintptr_t)s->pos % sizeof(double)) == 0;
+}
+
 /**
 * RTPOINTARRAY
 * Read a dynamically sized point array and advance the parse state forward.
@@ -353,7 +363,10 @@ static RTPOINTARRAY* ptarray_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s
   /* If we're in a native endianness, we can just copy the data directly! */
   if( ! s->swap_bytes )
   {
-    pa = ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+    if ( wkb_parse_state_can_reference(s) )
+      pa = ptarray_construct_reference_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+    else
+      pa = ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
     s->pos += pa_size;
   }
   /* Otherwise we have to read each double, separately. */
@@ -400,7 +413,10 @@ static RTPOINT* rtpoint_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s)
   /* If we're in a native endianness, we can just copy the data directly! */
   if( ! s->swap_bytes )
   {
-    pa = ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+    if ( wkb_parse_state_can_reference(s) )
+      pa = ptarray_construct_reference_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
+    else
+      pa = ptarray_construct_copy_data(ctx, s->has_z, s->has_m, npoints, (uint8_t*)s->pos);
     s->pos += pa_size;
   }
   /* Otherwise we have to read each double, separately */
@@ -761,7 +777,7 @@ RTGEOM* rtgeom_from_wkb_state(const RTCTX *ctx, wkb_parse_state *s)
 * Check is a bitmask of: RT_PARSER_CHECK_MINPOINTS, RT_PARSER_CHECK_ODD,
 * RT_PARSER_CHECK_CLOSURE, RT_PARSER_CHECK_NONE, RT_PARSER_CHECK_ALL
 */
-RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check)
+static RTGEOM* rtgeom_from_wkb_buffer(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check, int reference)
 {
   wkb_parse_state s;
 
@@ -776,6 +792,7 @@ RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_s
   s.has_m = RT_FALSE;
   s.has_srid = RT_FALSE;
   s.pos = wkb;
+  s.reference = reference;
 
   /* Hand the check catch-all values */
   if ( check & RT_PARSER_CHECK_NONE )
@@ -786,6 +803,16 @@ RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_s
   return rtgeom_from_wkb_state(ctx, &s);
 }
 
+RTGEOM* rtgeom_from_wkb(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check)
+{
+  return rtgeom_from_wkb_buffer(ctx, wkb, wkb_size, check, RT_FALSE);
+}
+
+RTGEOM* rtgeom_from_wkb_reference(const RTCTX *ctx, const uint8_t *wkb, const size_t wkb_size, const char check)
+{
+  return rtgeom_from_wkb_buffer(ctx, wkb, wkb_size, check, RT_TRUE);
+}
+
 RTGEOM* rtgeom_from_hexwkb(const RTCTX *ctx, const char *hexwkb, const char check)
 {
   int hexwkb_len;
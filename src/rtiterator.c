@@ -132,6 +132,10 @@ unroll_collection(const RTCTX *ctx, RTPOINTITERATOR* s)
   c = (RTCOLLECTION*) s->geoms->item;
   s->geoms = pop_node(ctx, s->geoms);
 
+  /* Its points may change under the box */
+  if (s->allow_modification)
+    rtgeom_drop_bbox(ctx, (RTGEOM*) c);
+
   for (i = c->ngeoms - 1; i >= 0; i--)
   {
     RTGEOM* g = rtcollection_getsubgeom(ctx, c, i);
@@ -180,6 +184,8 @@ rtpointiterator_advance(const RTCTX *ctx, RTPOINTITERATOR* s)
     s->i = 0;
     g = s->geoms->item;
     s->pointarrays = extract_pointarrays_from_rtgeom(ctx, g);
+    if (s->allow_modification)
+      rtgeom_drop_bbox(ctx, g);
 
     s->geoms = pop_node(ctx, s->geoms);
   }
@@ -242,24 +248,15 @@ rtpointiterator_modify_next(const RTCTX *ctx, RTPOINTITERATOR* s, const RTPOINT4
   return RT_SUCCESS;
 }
 
-RTPOINTITERATOR*
-rtpointiterator_create(const RTCTX *ctx, const RTGEOM* g)
-{
-  RTPOINTITERATOR* it = rtpointiterator_create_rw(ctx, (RTGEOM*) g);
-  it->allow_modification = RT_FALSE;
-
-  return it;
-}
-
-RTPOINTITERATOR*
-rtpointiterator_create_rw(const RTCTX *ctx, RTGEOM* g)
+static RTPOINTITERATOR*
+rtpointiterator_new(const RTCTX *ctx, RTGEOM* g, int allow_modification)
 {
   RTPOINTITERATOR* it = rtalloc(ctx, sizeof(RTPOINTITERATOR));
 
   it->geoms = NULL;
   it->pointarrays = NULL;
   it->i = 0;
-  it->allow_modification = RT_TRUE;
+  it->allow_modification = allow_modification;
 
   add_rtgeom_to_stack(ctx, it, g);
   rtpointiterator_advance(ctx, it);
@@ -267,6 +264,18 @@ rtpointiterator_create_rw(const RTCTX *ctx, RTGEOM* g)
   return it;
 }
 
+RTPOINTITERATOR*
+rtpointiterator_create(const RTCTX *ctx, const RTGEOM* g)
+{
+  return rtpointiterator_new(ctx, (RTGEOM*) g, RT_FALSE);
+}
+
+RTPOINTITERATOR*
+rtpointiterator_create_rw(const RTCTX *ctx, RTGEOM* g)
+{
+  return rtpointiterator_new(ctx, g, RT_TRUE);
+}
+
 void
 rtpointiterator_destroy(const RTCTX *ctx, RTPOINTITERATOR* s)
 {
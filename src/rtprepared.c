@@ -0,0 +1,281 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+
+/* Geometries prepared for repeated 2D measurements */
+
+#include "rttopo_config.h"
+#include <float.h>
+
+#include "measures.h"
+#include "rtgeom_log.h"
+
+
+RTPREPARED *
+rtgeom_prepare(const RTCTX *ctx, const RTGEOM *geom)
+{
+  RTPREPARED *prep = rtalloc(ctx, sizeof(RTPREPARED));
+
+  prep->geom = geom;
+  prep->gbox.flags = geom->flags;
+  prep->has_gbox = ( rtgeom_calculate_gbox_cartesian(ctx, geom, &(prep->gbox)) == RT_SUCCESS );
+  prep->tree = rtgeom_rect_tree_create(ctx, geom);
+
+  return prep;
+}
+
+void
+rtprepared_free(const RTCTX *ctx, RTPREPARED *prep)
+{
+  rtgeom_rect_tree_destroy(ctx, prep->tree);
+  rtfree(ctx, prep);
+}
+
+/**
+* Measure between the prepared geometry (first) and another one,
+* using the edge index whenever both sides can be indexed.
+* Returns DIST_INTERRUPTED like rt_dist2d_comp.
+*/
+static int
+rtprepared_measure(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *geom, DISTPTS *dl)
+{
+  RTRECTTREE *tree;
+  int ret;
+
+  /* Prepared geometry has arcs */
+  if ( ! prep->tree->tree && prep->has_gbox )
+    return rt_dist2d_comp(ctx, prep->geom, geom, dl);
+
+  /* Single points are the common case, index them on the stack */
+  if ( geom->type == RTPOINTTYPE && ! rtgeom_is_empty(ctx, geom) )
+  {
+    RTRECTTREE ptree;
+    RECT_NODE node;
+    const RTPOINT2D *pt = rt_getPoint2d_cp(ctx, ((RTPOINT*)geom)->point, 0);
+
+    node.xmin = node.xmax = pt->x;
+    node.ymin = node.ymax = pt->y;
+    node.left_node = node.right_node = NULL;
+    node.p1 = node.p2 = (RTPOINT2D*)pt;
+
+    ptree.geom = geom;
+    ptree.tree = &node;
+    ptree.npolys = 0;
+    ptree.polys = NULL;
+    ptree.ncomps = 1;
+    ptree.comps = &pt;
+
+    return rt_dist2d_rect_tree(ctx, prep->tree, &ptree, dl);
+  }
+
+  tree = rtgeom_rect_tree_create(ctx, geom);
+  if ( ! tree->tree && ! rtgeom_is_empty(ctx, geom) )
+    ret = rt_dist2d_comp(ctx, prep->geom, geom, dl);
+  else
+    ret = rt_dist2d_rect_tree(ctx, prep->tree, tree, dl);
+  rtgeom_rect_tree_destroy(ctx, tree);
+
+  return ret;
+}
+
+double
+rtprepared_mindistance2d(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *geom)
+{
+  DISTPTS thedl;
+  int ret;
+  RTDEBUG(ctx, 2, "rtprepared_mindistance2d is called");
+
+  rt_dist2d_distpts_init(ctx, &thedl, DIST_MIN);
+  ret = rtprepared_measure(ctx, prep, geom, &thedl);
+  if (ret == DIST_INTERRUPTED)
+    return -1;
+  if (ret)
+  {
+    return thedl.distance;
+  }
+  /*should never get here. all cases ought to be error handled earlier*/
+  rterror(ctx, "Some unspecified error.");
+  return FLT_MAX;
+}
+
+double
+rtprepared_maxdistance2d(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *geom)
+{
+  DISTPTS thedl;
+  int ret;
+  RTDEBUG(ctx, 2, "rtprepared_maxdistance2d is called");
+
+  rt_dist2d_distpts_init(ctx, &thedl, DIST_MAX);
+  thedl.distance = -1;
+  ret = rtprepared_measure(ctx, prep, geom, &thedl);
+  if (ret == DIST_INTERRUPTED)
+    return -1;
+  if (ret)
+  {
+    return thedl.distance;
+  }
+  /*should never get here. all cases ought to be error handled earlier*/
+  rterror(ctx, "Some unspecified error.");
+  return -1;
+}
+
+int
+rtprepared_dwithin2d(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *geom, double tolerance)
+{
+  RTGBOX box;
+  DISTPTS thedl;
+  int ret;
+  RTDEBUG(ctx, 2, "rtprepared_dwithin2d is called");
+
+  if ( tolerance < 0 )
+  {
+    rterror(ctx, "Tolerance cannot be less than zero");
+    return RT_FALSE;
+  }
+
+  if ( ! prep->has_gbox || rtgeom_is_empty(ctx, geom) )
+    return RT_FALSE;
+
+  if ( rtgeom_calculate_gbox_cartesian(ctx, geom, &box) == RT_SUCCESS )
+  {
+    gbox_expand(ctx, &box, tolerance);
+    if ( ! gbox_overlaps_2d(ctx, &(prep->gbox), &box) )
+      return RT_FALSE;
+  }
+
+  rt_dist2d_distpts_init(ctx, &thedl, DIST_MIN);
+  thedl.tolerance = tolerance;
+  /* Nothing farther than the tolerance matters, let it be pruned */
+  thedl.distance = tolerance + FP_TOLERANCE;
+  ret = rtprepared_measure(ctx, prep, geom, &thedl);
+  /* Not proven within, see rtgeom_dwithin2d */
+  if (ret == DIST_INTERRUPTED)
+    return RT_FALSE;
+  if (!ret)
+  {
+    /*should never get here. all cases ought to be error handled earlier*/
+    rterror(ctx, "Some unspecified error.");
+    return RT_FALSE;
+  }
+  return thedl.distance <= tolerance;
+}
+
+RTGEOM *
+rtprepared_closest_point(const RTCTX *ctx, const RTPREPARED *prep, const RTGEOM *geom)
+{
+  DISTPTS thedl;
+  int srid = prep->geom->srid;
+  int ret;
+  RTDEBUG(ctx, 2, "rtprepared_closest_point is called");
+
+  rt_dist2d_distpts_init(ctx, &thedl, DIST_MIN);
+  ret = rtprepared_measure(ctx, prep, geom, &thedl);
+  if (ret == DIST_INTERRUPTED)
+    return NULL;
+  if (!ret)
+  {
+    /*should never get here. all cases ought to be error handled earlier*/
+    rterror(ctx, "Some unspecified error.");
+    return (RTGEOM *)rtcollection_construct_empty(ctx, RTCOLLECTIONTYPE, srid, 0, 0);
+  }
+  if (thedl.distance == FLT_MAX)
+  {
+    RTDEBUG(ctx, 3, "didn't find geometries to measure between, returning null");
+    return (RTGEOM *)rtcollection_construct_empty(ctx, RTCOLLECTIONTYPE, srid, 0, 0);
+  }
+  return (RTGEOM *)rtpoint_make2d(ctx, srid, thedl.p1.x, thedl.p1.y);
+}
+
+/**
+* Point location against the areas of a geometry with arcs,
+* which could not be indexed.
+*/
+static int
+rtgeom_areas_contain_point(const RTCTX *ctx, const RTGEOM *geom, const RTPOINT2D *pt)
+{
+  int i, r;
+
+  if ( rtgeom_is_empty(ctx, geom) )
+    return RT_OUTSIDE;
+
+  switch ( geom->type )
+  {
+    case RTTRIANGLETYPE:
+      return ptarray_contains_point(ctx, ((const RTTRIANGLE*)geom)->points, pt);
+    case RTPOLYGONTYPE:
+    {
+      const RTPOLY *poly = (const RTPOLY*)geom;
+      r = ptarray_contains_point(ctx, poly->rings[0], pt);
+      for ( i = 1; r == RT_INSIDE && i < poly->nrings; i++ )
+      {
+        switch ( ptarray_contains_point(ctx, poly->rings[i], pt) )
+        {
+          case RT_INSIDE: r = RT_OUTSIDE; break;
+          case RT_BOUNDARY: r = RT_BOUNDARY; break;
+        }
+      }
+      return r;
+    }
+    case RTCURVEPOLYTYPE:
+    {
+      const RTCURVEPOLY *poly = (const RTCURVEPOLY*)geom;
+      r = rtgeom_contains_point(ctx, poly->rings[0], pt);
+      for ( i = 1; r == RT_INSIDE && i < poly->nrings; i++ )
+      {
+        switch ( rtgeom_contains_point(ctx, poly->rings[i], pt) )
+        {
+          case RT_INSIDE: r = RT_OUTSIDE; break;
+          case RT_BOUNDARY: r = RT_BOUNDARY; break;
+        }
+      }
+      return r;
+    }
+    case RTMULTIPOLYGONTYPE:
+    case RTMULTISURFACETYPE:
+    case RTCOLLECTIONTYPE:
+    case RTPOLYHEDRALSURFACETYPE:
+    case RTTINTYPE:
+    {
+      const RTCOLLECTION *col = (const RTCOLLECTION*)geom;
+      for ( i = 0; i < col->ngeoms; i++ )
+      {
+        r = rtgeom_areas_contain_point(ctx, col->geoms[i], pt);
+        if ( r != RT_OUTSIDE )
+          return r;
+      }
+      return RT_OUTSIDE;
+    }
+    default:
+      return RT_OUTSIDE;
+  }
+}
+
+int
+rtprepared_contains_point(const RTCTX *ctx, const RTPREPARED *prep, const RTPOINT2D *pt)
+{
+  if ( ! prep->has_gbox || ! gbox_contains_point2d(ctx, &(prep->gbox), pt) )
+    return RT_OUTSIDE;
+
+  if ( ! prep->tree->tree )
+    return rtgeom_areas_contain_point(ctx, prep->geom, pt);
+
+  return rect_tree_geom_contains_point(ctx, prep->tree, pt);
+}
@@ -634,6 +634,211 @@ static double ptarray_area_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa, co
 }
 #endif /* else ! PROJ_GEODESIC */
 
+/**
+* Shared state of the inverse geodesic problem, set up once for the
+* spheroid and reused across many point pairs.
+*/
+typedef struct
+{
+  const SPHEROID *spheroid;
+#if PROJ_GEODESIC
+  struct geod_geodesic gd;
+#endif
+} SPHEROID_INVERSE;
+
+static void spheroid_inverse_init(const RTCTX *ctx, SPHEROID_INVERSE *inv, const SPHEROID *spheroid)
+{
+  inv->spheroid = spheroid;
+#if PROJ_GEODESIC
+  geod_init(&(inv->gd), spheroid->a, spheroid->f);
+#endif
+}
+
+static double spheroid_inverse_distance(const RTCTX *ctx, const SPHEROID_INVERSE *inv, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b)
+{
+  /* Sphere special case, axes equal */
+  if ( inv->spheroid->a == inv->spheroid->b )
+    return inv->spheroid->radius * sphere_distance(ctx, a, b);
+#if PROJ_GEODESIC
+  {
+    double s12; /* return distance */
+    geod_inverse(&(inv->gd), a->lat * 180.0 / M_PI, a->lon * 180.0 / M_PI,
+                 b->lat * 180.0 / M_PI, b->lon * 180.0 / M_PI, &s12, 0, 0);
+    return s12;
+  }
+#else
+  return spheroid_distance(ctx, a, b, inv->spheroid);
+#endif
+}
+
+/**
+* Earth centered coordinates of a location on the spheroid surface,
+* in spheroid units. The straight chord between two such points never
+* exceeds the geodesic joining them, which makes it a cheap lower bound.
+*/
+static void spheroid_geocentric(const RTCTX *ctx, const SPHEROID *spheroid, const GEOGRAPHIC_POINT *g, POINT3D *p)
+{
+  double e_sq = (POW2(spheroid->a) - POW2(spheroid->b)) / POW2(spheroid->a);
+  double sin_lat = sin(g->lat);
+  double cos_lat = cos(g->lat);
+  double n = spheroid->a / sqrt(1.0 - e_sq * sin_lat * sin_lat);
+
+  p->x = n * cos_lat * cos(g->lon);
+  p->y = n * cos_lat * sin(g->lon);
+  p->z = n * (1.0 - e_sq) * sin_lat;
+}
+
+/**
+* Computes the spheroidal distances from one location to each of
+* a list of locations, setting up the geodesic problem only once.
+*
+* @param a - location to measure from
+* @param b - locations to measure to
+* @param n - number of locations in b
+* @param distances - receives the n distances, in spheroid units
+*/
+void spheroid_distance_batch(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, const GEOGRAPHIC_POINT *b, int n, const SPHEROID *spheroid, double *distances)
+{
+  SPHEROID_INVERSE inv;
+  int i;
+
+  spheroid_inverse_init(ctx, &inv, spheroid);
+  for ( i = 0; i < n; i++ )
+    distances[i] = spheroid_inverse_distance(ctx, &inv, a, &(b[i]));
+}
+
+/**
+* Computes the shortest spheroidal distance between any location of
+* a and any location of b.
+*
+* Chord lengths between the geocentric coordinates bound every pair
+* from below, so the inverse geodesic problem is only solved for the
+* pairs that can still beat the current minimum, nearest chord first.
+* The search stops as soon as a distance below tolerance is found.
+*
+* @param ia, ib - if not NULL, receive the indexes of the closest pair
+* @return spheroidal distance in spheroid units, -1 if a or b is empty
+*/
+double spheroid_distance_min(const RTCTX *ctx, const GEOGRAPHIC_POINT *a, int na, const GEOGRAPHIC_POINT *b, int nb, const SPHEROID *spheroid, double tolerance, int *ia, int *ib)
+{
+  SPHEROID_INVERSE inv;
+  POINT3D *pb, pa;
+  double *chord2;
+  double distance = FLT_MAX;
+  double best2 = POW2(distance);
+  int besta = 0, bestb = 0;
+  int i, j;
+
+  if ( na < 1 || nb < 1 )
+    return -1.0;
+
+  spheroid_inverse_init(ctx, &inv, spheroid);
+  pb = rtalloc(ctx, sizeof(POINT3D) * nb);
+  chord2 = rtalloc(ctx, sizeof(double) * nb);
+  for ( j = 0; j < nb; j++ )
+    spheroid_geocentric(ctx, spheroid, &(b[j]), &(pb[j]));
+
+  for ( i = 0; i < na && distance >= tolerance; i++ )
+  {
+    double d, min2;
+    int jmin = 0;
+
+    spheroid_geocentric(ctx, spheroid, &(a[i]), &pa);
+
+    /* Squared chords of the whole row first, a tight loop the compiler can vectorize */
+    for ( j = 0; j < nb; j++ )
+      chord2[j] = POW2(pb[j].x - pa.x) + POW2(pb[j].y - pa.y) + POW2(pb[j].z - pa.z);
+
+    min2 = chord2[0];
+    for ( j = 1; j < nb; j++ )
+    {
+      if ( chord2[j] < min2 )
+      {
+        min2 = chord2[j];
+        jmin = j;
+      }
+    }
+
+    /* Nothing in this row can beat the current minimum */
+    if ( min2 >= best2 )
+      continue;
+
+    /* Nearest chord first, it most likely holds the nearest geodesic */
+    d = spheroid_inverse_distance(ctx, &inv, &(a[i]), &(b[jmin]));
+    if ( d < distance )
+    {
+      distance = d;
+      best2 = POW2(d);
+      besta = i;
+      bestb = jmin;
+    }
+
+    for ( j = 0; j < nb && distance >= tolerance; j++ )
+    {
+      if ( j == jmin || chord2[j] >= best2 )
+        continue;
+      d = spheroid_inverse_distance(ctx, &inv, &(a[i]), &(b[j]));
+      if ( d < distance )
+      {
+        distance = d;
+        best2 = POW2(d);
+        besta = i;
+        bestb = j;
+      }
+    }
+  }
+
+  rtfree(ctx, pb);
+  rtfree(ctx, chord2);
+
+  if ( ia ) *ia = besta;
+  if ( ib ) *ib = bestb;
+  return distance;
+}
+
+static GEOGRAPHIC_POINT* ptarray_geographic_points(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  GEOGRAPHIC_POINT *g = rtalloc(ctx, sizeof(GEOGRAPHIC_POINT) * (pa->npoints ? pa->npoints : 1));
+  const RTPOINT2D *p;
+  int i;
+
+  for ( i = 0; i < pa->npoints; i++ )
+  {
+    p = rt_getPoint2d_cp(ctx, pa, i);
+    geographic_point_init(ctx, p->x, p->y, &(g[i]));
+  }
+  return g;
+}
+
+void ptarray_distances_spheroid(const RTCTX *ctx, const RTPOINT2D *pt, const RTPOINTARRAY *pa, const SPHEROID *spheroid, double *distances)
+{
+  GEOGRAPHIC_POINT g, *gpa;
+
+  if ( pa->npoints < 1 )
+    return;
+
+  geographic_point_init(ctx, pt->x, pt->y, &g);
+  gpa = ptarray_geographic_points(ctx, pa);
+  spheroid_distance_batch(ctx, &g, gpa, pa->npoints, spheroid, distances);
+  rtfree(ctx, gpa);
+}
+
+double ptarray_nearest_vertices_spheroid(const RTCTX *ctx, const RTPOINTARRAY *pa1, const RTPOINTARRAY *pa2, const SPHEROID *spheroid, double tolerance, int *i1, int *i2)
+{
+  GEOGRAPHIC_POINT *g1, *g2;
+  double distance;
+
+  if ( pa1->npoints < 1 || pa2->npoints < 1 )
+    return -1.0;
+
+  g1 = ptarray_geographic_points(ctx, pa1);
+  g2 = ptarray_geographic_points(ctx, pa2);
+  distance = spheroid_distance_min(ctx, g1, pa1->npoints, g2, pa2->npoints, spheroid, tolerance, i1, i2);
+  rtfree(ctx, g1);
+  rtfree(ctx, g2);
+  return distance;
+}
+
 /**
 * Calculate the area of an RTGEOM. Anything except POLYGON, MULTIPOLYGON
 * and GEOMETRYCOLLECTION return zero immediately. Multi's recurse, polygons
@@ -115,7 +115,7 @@ static double interpolate_arc(const RTCTX *ctx, double angle, double a1, double
 }
 
 static RTPOINTARRAY *
-rtcircle_stroke(const RTCTX *ctx, const RTPOINT4D *p1, const RTPOINT4D *p2, const RTPOINT4D *p3, uint32_t perQuad)
+rtcircle_stroke(const RTCTX *ctx, const RTPOINT4D *p1, const RTPOINT4D *p2, const RTPOINT4D *p3, uint32_t perQuad, int hasz, int hasm)
 {
   RTPOINT2D center;
   RTPOINT2D *t1 = (RTPOINT2D*)p1;
@@ -186,8 +186,8 @@ rtcircle_stroke(const RTCTX *ctx, const RTPOINT4D *p1, const RTPOINT4D *p2, cons
     clockwise = RT_FALSE;
   }
 
-  /* Initialize point array */
-  pa = ptarray_construct_empty(ctx, 1, 1, 32);
+  /* Initialize point array, sized for the whole sweep */
+  pa = ptarray_construct_empty(ctx, hasz, hasm, 2 + (uint32_t)(fabs(a3 - a1) / fabs(increment)));
 
   /* Sweep from a1 to a3 */
   ptarray_append_point(ctx, pa, p1, RT_FALSE);
@@ -208,8 +208,8 @@ rtcircstring_stroke(const RTCTX *ctx, const RTCIRCSTRING *icurve, uint32_t perQu
   RTLINE *oline;
   RTPOINTARRAY *ptarray;
   RTPOINTARRAY *tmp;
-  uint32_t i, j;
-  RTPOINT4D p1, p2, p3, p4;
+  uint32_t i;
+  RTPOINT4D p1, p2, p3;
 
   RTDEBUGF(ctx, 2, "rtcircstring_stroke called., dim = %d", icurve->points->flags);
 
@@ -222,28 +222,20 @@ rtcircstring_stroke(const RTCTX *ctx, const RTCIRCSTRING *icurve, uint32_t perQu
     rt_getPoint4d_p(ctx, icurve->points, i - 2, &p1);
     rt_getPoint4d_p(ctx, icurve->points, i - 1, &p2);
     rt_getPoint4d_p(ctx, icurve->points, i, &p3);
-    tmp = rtcircle_stroke(ctx, &p1, &p2, &p3, perQuad);
+    tmp = rtcircle_stroke(ctx, &p1, &p2, &p3, perQuad, RTFLAGS_GET_Z(ptarray->flags), RTFLAGS_GET_M(ptarray->flags));
 
     if (tmp)
     {
       RTDEBUGF(ctx, 3, "rtcircstring_stroke: generated %d points", tmp->npoints);
 
-      for (j = 0; j < tmp->npoints; j++)
-      {
-        rt_getPoint4d_p(ctx, tmp, j, &p4);
-        ptarray_append_point(ctx, ptarray, &p4, RT_TRUE);
-      }
+      ptarray_append_points(ctx, ptarray, tmp->serialized_pointlist, tmp->npoints, RT_TRUE);
       ptarray_free(ctx, tmp);
     }
     else
     {
       RTDEBUG(ctx, 3, "rtcircstring_stroke: points are colinear, returning curve points as line");
 
-      for (j = i - 2 ; j < i ; j++)
-      {
-        rt_getPoint4d_p(ctx, icurve->points, j, &p4);
-        ptarray_append_point(ctx, ptarray, &p4, RT_TRUE);
-      }
+      ptarray_append_points(ctx, ptarray, rt_getPoint_internal(ctx, icurve->points, i - 2), 2, RT_TRUE);
     }
 
   }
@@ -254,14 +246,36 @@ rtcircstring_stroke(const RTCTX *ctx, const RTCIRCSTRING *icurve, uint32_t perQu
   return oline;
 }
 
+/**
+* Append all the points of in to pa, copying them in bulk unless
+* their dimensions differ.
+*/
+static void
+ptarray_append_stroked(const RTCTX *ctx, RTPOINTARRAY *pa, const RTPOINTARRAY *in)
+{
+  RTPOINT4D p;
+  uint32_t j;
+
+  if ( RTFLAGS_GET_ZM(pa->flags) == RTFLAGS_GET_ZM(in->flags) )
+  {
+    ptarray_append_points(ctx, pa, in->serialized_pointlist, in->npoints, RT_TRUE);
+    return;
+  }
+
+  for (j = 0; j < in->npoints; j++)
+  {
+    rt_getPoint4d_p(ctx, in, j, &p);
+    ptarray_append_point(ctx, pa, &p, RT_TRUE);
+  }
+}
+
 RTLINE *
 rtcompound_stroke(const RTCTX *ctx, const RTCOMPOUND *icompound, uint32_t perQuad)
 {
   RTGEOM *geom;
   RTPOINTARRAY *ptarray = NULL, *ptarray_out = NULL;
   RTLINE *tmp = NULL;
-  uint32_t i, j;
-  RTPOINT4D p;
+  uint32_t i;
 
   RTDEBUG(ctx, 2, "rtcompound_stroke called.");
 
@@ -273,21 +287,13 @@ rtcompound_stroke(const RTCTX *ctx, const RTCOMPOUND *icompound, uint32_t perQua
     if (geom->type == RTCIRCSTRINGTYPE)
     {
       tmp = rtcircstring_stroke(ctx, (RTCIRCSTRING *)geom, perQuad);
-      for (j = 0; j < tmp->points->npoints; j++)
-      {
-        rt_getPoint4d_p(ctx, tmp->points, j, &p);
-        ptarray_append_point(ctx, ptarray, &p, RT_TRUE);
-      }
+      ptarray_append_stroked(ctx, ptarray, tmp->points);
       rtline_free(ctx, tmp);
     }
     else if (geom->type == RTLINETYPE)
     {
       tmp = (RTLINE *)geom;
-      for (j = 0; j < tmp->points->npoints; j++)
-      {
-        rt_getPoint4d_p(ctx, tmp->points, j, &p);
-        ptarray_append_point(ctx, ptarray, &p, RT_TRUE);
-      }
+      ptarray_append_stroked(ctx, ptarray, tmp->points);
     }
     else
     {
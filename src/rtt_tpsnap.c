@@ -411,6 +411,8 @@ _rtgeom_tpsnap_ptarray_remove(const RTCTX *ctx, RTPOINTARRAY *pa,
     int closest_segment_number;
     double closest_segment_distance = state->tolerance_removal+1;
 
+    RT_ON_INTERRUPT(return -1);
+
     rt_getPoint2d_p(ctx, pa, i, &V);
 
     RTDEBUGF(ctx, 2, "Analyzing internal vertex POINT(%.15g %.15g)", V.x, V.y);
@@ -643,6 +645,8 @@ _rtgeom_tpsnap_ptarray_add(const RTCTX *ctx, RTPOINTARRAY *pa,
     int foundSnap;
     RTT_SNAPV_ARRAY vset;
 
+    RT_ON_INTERRUPT(return -1);
+
     lookingForSnap = 0;
     RTT_SNAPV_ARRAY_INIT(ctx, &vset);
 
@@ -123,6 +123,79 @@ int rect_tree_intersects_tree(const RTCTX *ctx, const RECT_NODE *n1, const RECT_
 }
 
 
+/**
+* Accumulate the winding number of a ring tree around a point,
+* skipping subtrees out of the point vertical range or entirely
+* on its left, as those cannot contribute.
+* Returns RT_TRUE as soon as the point is found on an edge.
+*/
+static int rect_node_ring_winding(const RTCTX *ctx, const RECT_NODE *node, const RTPOINT2D *pt, int *wn)
+{
+  double side;
+
+  if ( pt->y < node->ymin || pt->y > node->ymax || pt->x > node->xmax )
+    return RT_FALSE;
+
+  if ( ! rect_node_is_leaf(ctx, node) )
+  {
+    return rect_node_ring_winding(ctx, node->left_node, pt, wn) ||
+           rect_node_ring_winding(ctx, node->right_node, pt, wn);
+  }
+
+  /* Same rules as ptarray_contains_point_partial */
+  side = rt_segment_side(ctx, node->p1, node->p2, pt);
+  if ( (side == 0) && rt_pt_in_seg(ctx, pt, node->p1, node->p2) )
+    return RT_TRUE;
+
+  if ( (side < 0) && (node->p1->y <= pt->y) && (pt->y < node->p2->y) )
+    (*wn)++;
+  else if ( (side > 0) && (node->p2->y <= pt->y) && (pt->y < node->p1->y) )
+    (*wn)--;
+
+  return RT_FALSE;
+}
+
+/**
+* Point in ring test on a tree built by rect_tree_new over a closed ring.
+* Returns RT_INSIDE, RT_BOUNDARY or RT_OUTSIDE.
+*/
+int rect_tree_ring_contains_point(const RTCTX *ctx, const RECT_NODE *ring, const RTPOINT2D *pt)
+{
+  int wn = 0;
+
+  if ( rect_node_ring_winding(ctx, ring, pt, &wn) )
+    return RT_BOUNDARY;
+
+  return wn ? RT_INSIDE : RT_OUTSIDE;
+}
+
+/**
+* Minimum distance between the boxes of two nodes, zero if they overlap.
+*/
+double rect_node_distance(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2)
+{
+  double dx = FP_MAX(n1->xmin - n2->xmax, n2->xmin - n1->xmax);
+  double dy = FP_MAX(n1->ymin - n2->ymax, n2->ymin - n1->ymax);
+
+  if ( dx < 0.0 ) dx = 0.0;
+  if ( dy < 0.0 ) dy = 0.0;
+
+  return sqrt(dx*dx + dy*dy);
+}
+
+/**
+* Maximum distance between the boxes of two nodes, that is between
+* their two farthest corners.
+*/
+double rect_node_max_distance(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2)
+{
+  double dx = FP_MAX(n1->xmax - n2->xmin, n2->xmax - n1->xmin);
+  double dy = FP_MAX(n1->ymax - n2->ymin, n2->ymax - n1->ymin);
+
+  return sqrt(dx*dx + dy*dy);
+}
+
+
 /**
 * Create a new leaf node, calculating a measure value for each point on the
 * edge and storing pointers back to the end points for later.
@@ -151,6 +224,27 @@ RECT_NODE* rect_node_leaf_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
   return node;
 }
 
+/**
+* Create a new leaf node for an isolated point, or for a point array
+* made of a single location. Both end points reference the same vertex.
+*/
+RECT_NODE* rect_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i)
+{
+  RTPOINT2D *p;
+  RECT_NODE *node;
+
+  p = (RTPOINT2D*)rt_getPoint_internal(ctx, pa, i);
+
+  node = rtalloc(ctx, sizeof(RECT_NODE));
+  node->p1 = p;
+  node->p2 = p;
+  node->xmin = node->xmax = p->x;
+  node->ymin = node->ymax = p->y;
+  node->left_node = NULL;
+  node->right_node = NULL;
+  return node;
+}
+
 /**
 * Create a new internal node, calculating the new measure range for the node,
 * and storing pointers to the child nodes.
@@ -169,6 +263,45 @@ RECT_NODE* rect_node_internal_new(const RTCTX *ctx, RECT_NODE *left_node, RECT_N
   return node;
 }
 
+/**
+* Pair up a flat list of nodes, level by level, until a single
+* root is left. The list is used as scratch space.
+* Returns NULL for an empty list.
+*/
+static RECT_NODE* rect_tree_merge_nodes(const RTCTX *ctx, RECT_NODE **nodes, int num_children)
+{
+  int num_parents, j;
+
+  if ( num_children < 1 )
+    return NULL;
+
+  num_parents = num_children / 2;
+  while ( num_parents > 0 )
+  {
+    j = 0;
+    while ( j < num_parents )
+    {
+      /*
+      ** Each new parent includes pointers to the children, so even though
+      ** we are over-writing their place in the list, we still have references
+      ** to them via the tree.
+      */
+      nodes[j] = rect_node_internal_new(ctx, nodes[2*j], nodes[(2*j)+1]);
+      j++;
+    }
+    /* Odd number of children, just copy the last node up a level */
+    if ( num_children % 2 )
+    {
+      nodes[j] = nodes[num_children - 1];
+      num_parents++;
+    }
+    num_children = num_parents;
+    num_parents = num_children / 2;
+  }
+
+  return nodes[0];
+}
+
 /**
 * Build a tree of nodes from a point array, one node per edge, and each
 * with an associated measure range along a one-dimensional space. We
@@ -176,7 +309,7 @@ RECT_NODE* rect_node_internal_new(const RTCTX *ctx, RECT_NODE *left_node, RECT_N
 */
 RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
 {
-  int num_edges, num_children, num_parents;
+  int num_edges;
   int i, j;
   RECT_NODE **nodes;
   RECT_NODE *node;
@@ -212,39 +345,240 @@ RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
   ** build the tree knowing that point arrays tend to have a
   ** reasonable amount of sorting already.
   */
+  tree = rect_tree_merge_nodes(ctx, nodes, j);
 
-  num_children = j;
-  num_parents = num_children / 2;
-  while ( num_parents > 0 )
+  /* Free the old list structure, leaving the tree in place */
+  rtfree(ctx, nodes);
+
+  return tree;
+
+}
+
+
+/**
+* Growable lists used while indexing a geometry
+*/
+typedef struct
+{
+  RECT_NODE **nodes;
+  int nnodes, maxnodes;
+  RECT_POLY *polys;
+  int npolys, maxpolys;
+  const RTPOINT2D **comps;
+  int ncomps, maxcomps;
+} RECT_TREE_BUILDER;
+
+static void rect_tree_builder_add_node(const RTCTX *ctx, RECT_TREE_BUILDER *b, RECT_NODE *node)
+{
+  if ( b->nnodes == b->maxnodes )
   {
-    j = 0;
-    while ( j < num_parents )
+    b->maxnodes *= 2;
+    b->nodes = rtrealloc(ctx, b->nodes, sizeof(RECT_NODE*) * b->maxnodes);
+  }
+  b->nodes[b->nnodes++] = node;
+}
+
+static void rect_tree_builder_add_comp(const RTCTX *ctx, RECT_TREE_BUILDER *b, const RTPOINTARRAY *pa)
+{
+  if ( b->ncomps == b->maxcomps )
+  {
+    b->maxcomps *= 2;
+    b->comps = rtrealloc(ctx, b->comps, sizeof(RTPOINT2D*) * b->maxcomps);
+  }
+  b->comps[b->ncomps++] = rt_getPoint2d_cp(ctx, pa, 0);
+}
+
+/**
+* Index a linear point array: its edges, or its single location
+* if all its edges have zero length.
+*/
+static void rect_tree_builder_add_ptarray(const RTCTX *ctx, RECT_TREE_BUILDER *b, const RTPOINTARRAY *pa)
+{
+  RECT_NODE *node;
+
+  if ( pa->npoints < 1 )
+    return;
+
+  node = rect_tree_new(ctx, pa);
+  if ( ! node )
+    node = rect_node_point_new(ctx, pa, 0);
+  rect_tree_builder_add_node(ctx, b, node);
+  rect_tree_builder_add_comp(ctx, b, pa);
+}
+
+static void rect_tree_builder_add_rings(const RTCTX *ctx, RECT_TREE_BUILDER *b, int nrings, RTPOINTARRAY **rings)
+{
+  RECT_POLY *poly;
+  int i;
+
+  if ( nrings < 1 || rings[0]->npoints < 1 )
+    return;
+
+  if ( b->npolys == b->maxpolys )
+  {
+    b->maxpolys *= 2;
+    b->polys = rtrealloc(ctx, b->polys, sizeof(RECT_POLY) * b->maxpolys);
+  }
+  poly = &(b->polys[b->npolys++]);
+  poly->nrings = nrings;
+  poly->rings = rtalloc(ctx, sizeof(RECT_NODE*) * nrings);
+
+  for ( i = 0; i < nrings; i++ )
+  {
+    poly->rings[i] = rect_tree_new(ctx, rings[i]);
+    if ( poly->rings[i] )
+      rect_tree_builder_add_node(ctx, b, poly->rings[i]);
+  }
+
+  /* Collapsed shell, index it as a point */
+  if ( ! poly->rings[0] )
+    rect_tree_builder_add_node(ctx, b, rect_node_point_new(ctx, rings[0], 0));
+
+  rect_tree_builder_add_comp(ctx, b, rings[0]);
+}
+
+/**
+* Recursively index all components of a geometry.
+* Returns RT_FAILURE if the geometry contains arcs.
+*/
+static int rect_tree_builder_add_geom(const RTCTX *ctx, RECT_TREE_BUILDER *b, const RTGEOM *geom)
+{
+  int i;
+
+  switch ( geom->type )
+  {
+    case RTPOINTTYPE:
+      rect_tree_builder_add_ptarray(ctx, b, ((RTPOINT*)geom)->point);
+      return RT_SUCCESS;
+    case RTLINETYPE:
+      rect_tree_builder_add_ptarray(ctx, b, ((RTLINE*)geom)->points);
+      return RT_SUCCESS;
+    case RTTRIANGLETYPE:
+      rect_tree_builder_add_rings(ctx, b, 1, &(((RTTRIANGLE*)geom)->points));
+      return RT_SUCCESS;
+    case RTPOLYGONTYPE:
     {
-      /*
-      ** Each new parent includes pointers to the children, so even though
-      ** we are over-writing their place in the list, we still have references
-      ** to them via the tree.
-      */
-      nodes[j] = rect_node_internal_new(ctx, nodes[2*j], nodes[(2*j)+1]);
-      j++;
+      RTPOLY *poly = (RTPOLY*)geom;
+      rect_tree_builder_add_rings(ctx, b, poly->nrings, poly->rings);
+      return RT_SUCCESS;
     }
-    /* Odd number of children, just copy the last node up a level */
-    if ( num_children % 2 )
+    case RTMULTIPOINTTYPE:
+    case RTMULTILINETYPE:
+    case RTMULTIPOLYGONTYPE:
+    case RTCOLLECTIONTYPE:
+    case RTCOMPOUNDTYPE:
+    case RTMULTICURVETYPE:
+    case RTMULTISURFACETYPE:
+    case RTPOLYHEDRALSURFACETYPE:
+    case RTTINTYPE:
     {
-      nodes[j] = nodes[num_children - 1];
-      num_parents++;
+      RTCOLLECTION *col = (RTCOLLECTION*)geom;
+      for ( i = 0; i < col->ngeoms; i++ )
+      {
+        if ( rect_tree_builder_add_geom(ctx, b, col->geoms[i]) == RT_FAILURE )
+          return RT_FAILURE;
+      }
+      return RT_SUCCESS;
     }
-    num_children = num_parents;
-    num_parents = num_children / 2;
+    default:
+      RTDEBUGF(ctx, 3, "rect_tree_builder_add_geom: cannot index %s", rttype_name(ctx, geom->type));
+      return RT_FAILURE;
   }
+}
 
-  /* Take a reference to the head of the tree*/
-  tree = nodes[0];
+RTRECTTREE* rtgeom_rect_tree_create(const RTCTX *ctx, const RTGEOM *geom)
+{
+  RECT_TREE_BUILDER b;
+  RTRECTTREE *tree;
+  int i;
 
-  /* Free the old list structure, leaving the tree in place */
-  rtfree(ctx, nodes);
+  b.nnodes = b.npolys = b.ncomps = 0;
+  b.maxnodes = b.maxpolys = b.maxcomps = 8;
+  b.nodes = rtalloc(ctx, sizeof(RECT_NODE*) * b.maxnodes);
+  b.polys = rtalloc(ctx, sizeof(RECT_POLY) * b.maxpolys);
+  b.comps = rtalloc(ctx, sizeof(RTPOINT2D*) * b.maxcomps);
+
+  tree = rtalloc(ctx, sizeof(RTRECTTREE));
+  tree->geom = geom;
+
+  if ( rect_tree_builder_add_geom(ctx, &b, geom) == RT_FAILURE )
+  {
+    /* Not indexable, distances will be computed the old way */
+    for ( i = 0; i < b.nnodes; i++ )
+      rect_tree_free(ctx, b.nodes[i]);
+    for ( i = 0; i < b.npolys; i++ )
+      rtfree(ctx, b.polys[i].rings);
+    b.nnodes = b.npolys = b.ncomps = 0;
+  }
+
+  tree->tree = rect_tree_merge_nodes(ctx, b.nodes, b.nnodes);
+  rtfree(ctx, b.nodes);
+
+  tree->npolys = b.npolys;
+  tree->polys = b.polys;
+  tree->ncomps = b.ncomps;
+  tree->comps = b.comps;
 
   return tree;
+}
 
+void rtgeom_rect_tree_destroy(const RTCTX *ctx, RTRECTTREE *tree)
+{
+  int i;
+
+  if ( tree->tree )
+    rect_tree_free(ctx, tree->tree);
+  for ( i = 0; i < tree->npolys; i++ )
+    rtfree(ctx, tree->polys[i].rings);
+  rtfree(ctx, tree->polys);
+  rtfree(ctx, tree->comps);
+  rtfree(ctx, tree);
 }
 
+/**
+* Test a point against the areal components of an indexed geometry.
+* Returns RT_INSIDE, RT_BOUNDARY or RT_OUTSIDE.
+*/
+int rect_tree_geom_contains_point(const RTCTX *ctx, const RTRECTTREE *tree, const RTPOINT2D *pt)
+{
+  int i, j, r;
+  const RECT_POLY *poly;
+  const RECT_NODE *shell;
+
+  for ( i = 0; i < tree->npolys; i++ )
+  {
+    poly = &(tree->polys[i]);
+    shell = poly->rings[0];
+    if ( ! shell )
+      continue;
+
+    if ( pt->x < shell->xmin || pt->x > shell->xmax ||
+         pt->y < shell->ymin || pt->y > shell->ymax )
+      continue;
+
+    r = rect_tree_ring_contains_point(ctx, shell, pt);
+    if ( r != RT_INSIDE )
+    {
+      if ( r == RT_BOUNDARY )
+        return RT_BOUNDARY;
+      continue;
+    }
+
+    /* Inside the shell, is it in a hole? */
+    for ( j = 1; j < poly->nrings; j++ )
+    {
+      if ( ! poly->rings[j] )
+        continue;
+      r = rect_tree_ring_contains_point(ctx, poly->rings[j], pt);
+      if ( r != RT_OUTSIDE )
+        break;
+    }
+
+    if ( j == poly->nrings )
+      return RT_INSIDE;
+    if ( r == RT_BOUNDARY )
+      return RT_BOUNDARY;
+  }
+
+  return RT_OUTSIDE;
+}
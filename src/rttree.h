@@ -23,6 +23,9 @@
  **********************************************************************/
 
 
+#ifndef _RTTREE_H
+#define _RTTREE_H 1
+
 typedef struct rect_node
 {
   double xmin;
@@ -41,3 +44,42 @@ void rect_tree_free(const RTCTX *ctx, RECT_NODE *node);
 RECT_NODE* rect_node_leaf_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i);
 RECT_NODE* rect_node_internal_new(const RTCTX *ctx, RECT_NODE *left_node, RECT_NODE *right_node);
 RECT_NODE* rect_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa);
+RECT_NODE* rect_node_point_new(const RTCTX *ctx, const RTPOINTARRAY *pa, int i);
+int rect_tree_ring_contains_point(const RTCTX *ctx, const RECT_NODE *ring, const RTPOINT2D *pt);
+double rect_node_distance(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2);
+double rect_node_max_distance(const RTCTX *ctx, const RECT_NODE *n1, const RECT_NODE *n2);
+
+/**
+* The ring trees of an areal component, shell first.
+* A NULL entry stands for a degenerate (zero-length) ring.
+*/
+typedef struct
+{
+  int nrings;
+  RECT_NODE **rings;
+} RECT_POLY;
+
+/**
+* Indexed representation of a whole geometry.
+*
+* All the edges (and isolated points) of the geometry live in a
+* single tree, whose subtrees are the per-ring trees referenced
+* by the areal components. One vertex per component is kept
+* for containment tests against areas of another geometry.
+*
+* Nodes point into the point arrays of the source geometry,
+* which must then outlive the tree.
+*/
+struct RTRECTTREE
+{
+  const RTGEOM *geom;     /* source geometry */
+  RECT_NODE *tree;        /* NULL if empty or not indexable (arcs) */
+  int npolys;
+  RECT_POLY *polys;
+  int ncomps;
+  const RTPOINT2D **comps; /* first vertex of each component */
+};
+
+int rect_tree_geom_contains_point(const RTCTX *ctx, const RTRECTTREE *tree, const RTPOINT2D *pt);
+
+#endif /* _RTTREE_H */
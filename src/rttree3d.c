@@ -0,0 +1,486 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+/* 3D bounding box hierarchies, for indexed 3D distances */
+
+#include "rttopo_config.h"
+
+#include "librttopo_geom_internal.h"
+#include "rtgeom_log.h"
+#include "rttree3d.h"
+
+
+static inline double aabb_coord(const RTPOINT3DZ *p, int axis)
+{
+  return axis == 0 ? p->x : ( axis == 1 ? p->y : p->z );
+}
+
+/**
+* The nodes of a tree are allocated in a single block, rooted at
+* its first node. Does not free underlying point array.
+*/
+void aabb_tree_free(const RTCTX *ctx, AABB_NODE *node)
+{
+  rtfree(ctx, node);
+}
+
+/**
+* Set up a leaf node for the edge starting at vertex i, or for
+* vertex i alone if it is the last one.
+*/
+static void aabb_node_leaf_init(const RTCTX *ctx, AABB_NODE *node, const RTPOINTARRAY *pa, int i)
+{
+  RTPOINT3DZ p1, p2;
+
+  rt_getPoint3dz_p(ctx, pa, i, &p1);
+  if ( i + 1 < pa->npoints )
+    rt_getPoint3dz_p(ctx, pa, i + 1, &p2);
+  else
+    p2 = p1;
+
+  node->min[0] = FP_MIN(p1.x, p2.x);
+  node->max[0] = FP_MAX(p1.x, p2.x);
+  node->min[1] = FP_MIN(p1.y, p2.y);
+  node->max[1] = FP_MAX(p1.y, p2.y);
+  node->min[2] = FP_MIN(p1.z, p2.z);
+  node->max[2] = FP_MAX(p1.z, p2.z);
+  node->left_node = NULL;
+  node->right_node = NULL;
+  node->index = i;
+}
+
+/**
+* Set up an internal node, covering both children.
+*/
+static AABB_NODE* aabb_node_internal_init(const RTCTX *ctx, AABB_NODE *node, AABB_NODE *left_node, AABB_NODE *right_node)
+{
+  int i;
+
+  for ( i = 0; i < 3; i++ )
+  {
+    node->min[i] = FP_MIN(left_node->min[i], right_node->min[i]);
+    node->max[i] = FP_MAX(left_node->max[i], right_node->max[i]);
+  }
+  node->left_node = left_node;
+  node->right_node = right_node;
+  node->index = -1;
+  return node;
+}
+
+/**
+* Build a tree of nodes from a point array, one leaf per edge, pairing
+* up consecutive edges level by level like rect_tree_new does.
+* The n leaves sit at the end of the block, and the n-1 internal
+* nodes are taken backwards before them, the root coming last.
+* Returns NULL for an empty array.
+*/
+AABB_NODE* aabb_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa)
+{
+  AABB_NODE **nodes, *block;
+  int num_children, num_parents, next, i, j;
+
+  if ( pa->npoints < 1 )
+    return NULL;
+
+  num_children = pa->npoints > 1 ? pa->npoints - 1 : 1;
+  block = rtalloc(ctx, sizeof(AABB_NODE) * (2 * num_children - 1));
+  nodes = rtalloc(ctx, sizeof(AABB_NODE*) * num_children);
+  next = num_children - 1;
+  for ( i = 0; i < num_children; i++ )
+  {
+    nodes[i] = &(block[next + i]);
+    aabb_node_leaf_init(ctx, nodes[i], pa, i);
+  }
+
+  num_parents = num_children / 2;
+  while ( num_parents > 0 )
+  {
+    for ( j = 0; j < num_parents; j++ )
+      nodes[j] = aabb_node_internal_init(ctx, &(block[--next]), nodes[2*j], nodes[(2*j)+1]);
+    /* Odd number of children, just copy the last node up a level */
+    if ( num_children % 2 )
+    {
+      nodes[j] = nodes[num_children - 1];
+      num_parents++;
+    }
+    num_children = num_parents;
+    num_parents = num_children / 2;
+  }
+
+  rtfree(ctx, nodes);
+  return block;
+}
+
+/**
+* Minimum distance between the boxes of two nodes, zero if they overlap.
+*/
+double aabb_node_distance(const RTCTX *ctx, const AABB_NODE *n1, const AABB_NODE *n2)
+{
+  double d, sum = 0.0;
+  int i;
+
+  for ( i = 0; i < 3; i++ )
+  {
+    d = FP_MAX(n1->min[i] - n2->max[i], n2->min[i] - n1->max[i]);
+    if ( d > 0.0 )
+      sum += d * d;
+  }
+  return sqrt(sum);
+}
+
+/**
+* Count the ring edges crossed by a ray cast from p along axis u, in
+* the plane of axes u and v, with the rules of pt_in_ring_3d.
+* Subtrees out of the ray range along v, or behind p along u, cannot
+* be crossed.
+*/
+static void aabb_node_ring_crossings(const RTCTX *ctx, const AABB_NODE *node, const RTPOINTARRAY *ring, const RTPOINT3DZ *p, int u, int v, int *cn)
+{
+  RTPOINT3DZ v1, v2;
+  double pu = aabb_coord(p, u), pv = aabb_coord(p, v);
+  double v1u, v1v, v2u, v2v, vt;
+
+  if ( pv < node->min[v] || pv >= node->max[v] || pu >= node->max[u] )
+    return;
+
+  if ( node->left_node )
+  {
+    aabb_node_ring_crossings(ctx, node->left_node, ring, p, u, v, cn);
+    aabb_node_ring_crossings(ctx, node->right_node, ring, p, u, v, cn);
+    return;
+  }
+
+  /* Single point ring, no edge */
+  if ( node->index + 1 >= ring->npoints )
+    return;
+
+  rt_getPoint3dz_p(ctx, ring, node->index, &v1);
+  rt_getPoint3dz_p(ctx, ring, node->index + 1, &v2);
+  v1u = aabb_coord(&v1, u);
+  v1v = aabb_coord(&v1, v);
+  v2u = aabb_coord(&v2, u);
+  v2v = aabb_coord(&v2, v);
+
+  if ( ((v1v <= pv) && (v2v > pv)) || ((v1v > pv) && (v2v <= pv)) )
+  {
+    vt = (pv - v1v) / (v2v - v1v);
+    if ( pu < v1u + vt * (v2u - v1u) )
+      ++(*cn);
+  }
+}
+
+/**
+* Point in ring test of a point lying on the plane of the ring, the
+* indexed counterpart of pt_in_ring_3d. The ring is projected on
+* the coordinate plane its own plane faces most.
+*/
+static int aabb_tree_ring_contains_point(const RTCTX *ctx, const AABB_NODE *tree, const RTPOINTARRAY *ring, const PLANE3D *plane, const RTPOINT3DZ *p)
+{
+  double ax = fabs(plane->pv.x), ay = fabs(plane->pv.y), az = fabs(plane->pv.z);
+  int cn = 0;
+
+  if ( az >= ax && az >= ay )
+    aabb_node_ring_crossings(ctx, tree, ring, p, 0, 1, &cn);
+  else if ( ay >= ax && ay >= az )
+    aabb_node_ring_crossings(ctx, tree, ring, p, 0, 2, &cn);
+  else
+    aabb_node_ring_crossings(ctx, tree, ring, p, 1, 2, &cn);
+
+  return cn & 1;
+}
+
+/**
+* Whether a point of the plane of a polygon component lies inside
+* its shell and outside all of its holes.
+*/
+int aabb_comp_contains_point(const RTCTX *ctx, const AABB_COMP *comp, const RTPOINT3DZ *p)
+{
+  int i;
+
+  if ( comp->type != RTPOLYGONTYPE )
+    return RT_FALSE;
+
+  if ( ! aabb_tree_ring_contains_point(ctx, comp->trees[0], comp->rings[0], &(comp->plane), p) )
+    return RT_FALSE;
+
+  for ( i = 1; i < comp->nrings; i++ )
+  {
+    if ( comp->trees[i] &&
+         aabb_tree_ring_contains_point(ctx, comp->trees[i], comp->rings[i], &(comp->plane), p) )
+      return RT_FALSE;
+  }
+  return RT_TRUE;
+}
+
+
+/**
+* Growable list of components used while indexing a geometry
+*/
+typedef struct
+{
+  AABB_COMP *comps;
+  int ncomps, maxcomps;
+} AABB_TREE_BUILDER;
+
+static void aabb_comp_free(const RTCTX *ctx, AABB_COMP *comp)
+{
+  int i;
+
+  for ( i = 0; i < comp->nrings; i++ )
+  {
+    if ( comp->trees[i] )
+      aabb_tree_free(ctx, comp->trees[i]);
+  }
+  rtfree(ctx, comp->trees);
+}
+
+static AABB_COMP* aabb_tree_builder_add_comp(const RTCTX *ctx, AABB_TREE_BUILDER *b, int type, int nrings, RTPOINTARRAY **rings)
+{
+  AABB_COMP *comp;
+  int i;
+
+  if ( b->ncomps == b->maxcomps )
+  {
+    b->maxcomps *= 2;
+    b->comps = rtrealloc(ctx, b->comps, sizeof(AABB_COMP) * b->maxcomps);
+  }
+  comp = &(b->comps[b->ncomps++]);
+  comp->type = type;
+  comp->nrings = nrings;
+  comp->rings = rings;
+  comp->trees = rtalloc(ctx, sizeof(AABB_NODE*) * nrings);
+  for ( i = 0; i < nrings; i++ )
+    comp->trees[i] = aabb_tree_new(ctx, rings[i]);
+  comp->pvlength = 0.0;
+  return comp;
+}
+
+/**
+* Recursively index all components of a geometry, skipping empty ones.
+* Returns RT_FAILURE on the types the 3D distance functions do not
+* handle, and on polygons without a plane.
+*/
+static int aabb_tree_builder_add_geom(const RTCTX *ctx, AABB_TREE_BUILDER *b, const RTGEOM *geom)
+{
+  int i;
+
+  if ( rtgeom_is_empty(ctx, geom) )
+    return RT_SUCCESS;
+
+  switch ( geom->type )
+  {
+    case RTPOINTTYPE:
+      aabb_tree_builder_add_comp(ctx, b, RTPOINTTYPE, 1, &(((RTPOINT*)geom)->point));
+      return RT_SUCCESS;
+    case RTLINETYPE:
+      aabb_tree_builder_add_comp(ctx, b, RTLINETYPE, 1, &(((RTLINE*)geom)->points));
+      return RT_SUCCESS;
+    case RTPOLYGONTYPE:
+    {
+      RTPOLY *poly = (RTPOLY*)geom;
+      AABB_COMP *comp;
+
+      /* define_plane needs at least a triangle */
+      if ( poly->rings[0]->npoints < 4 )
+        return RT_FAILURE;
+
+      comp = aabb_tree_builder_add_comp(ctx, b, RTPOLYGONTYPE, poly->nrings, poly->rings);
+      if ( ! define_plane(ctx, poly->rings[0], &(comp->plane)) )
+        return RT_FAILURE;
+      comp->pvlength = VECTORLENGTH(comp->plane.pv);
+      return RT_SUCCESS;
+    }
+    default:
+      if ( rtgeom_is_collection(ctx, geom) )
+      {
+        RTCOLLECTION *col = (RTCOLLECTION*)geom;
+        for ( i = 0; i < col->ngeoms; i++ )
+        {
+          if ( aabb_tree_builder_add_geom(ctx, b, col->geoms[i]) == RT_FAILURE )
+            return RT_FAILURE;
+        }
+        return RT_SUCCESS;
+      }
+      RTDEBUGF(ctx, 3, "aabb_tree_builder_add_geom: cannot index %s", rttype_name(ctx, geom->type));
+      return RT_FAILURE;
+  }
+}
+
+/**
+* Component nodes, with their key along the current split axis
+*/
+typedef struct
+{
+  AABB_NODE *node;
+  double key;
+} AABB_SORT_ITEM;
+
+/**
+* Partially order items lo to hi so that item nth is the one at
+* its final sorted position by key (Hoare's selection).
+*/
+static void aabb_select(AABB_SORT_ITEM *items, int lo, int hi, int nth)
+{
+  AABB_SORT_ITEM tmp;
+
+  while ( lo < hi )
+  {
+    double pivot = items[(lo + hi) / 2].key;
+    int i = lo, j = hi;
+
+    while ( i <= j )
+    {
+      while ( items[i].key < pivot ) i++;
+      while ( items[j].key > pivot ) j--;
+      if ( i <= j )
+      {
+        tmp = items[i];
+        items[i] = items[j];
+        items[j] = tmp;
+        i++;
+        j--;
+      }
+    }
+
+    if ( nth <= j )
+      hi = j;
+    else if ( nth >= i )
+      lo = i;
+    else
+      return;
+  }
+}
+
+/**
+* Build a tree over component nodes top-down, splitting them in two
+* halves along the axis their box centers spread the most, as
+* components are not spatially ordered like the edges of an array.
+* Internal nodes are taken backwards from *next in the block.
+*/
+static AABB_NODE* aabb_tree_split_nodes(const RTCTX *ctx, AABB_SORT_ITEM *items, int n, AABB_NODE *block, int *next)
+{
+  AABB_NODE *left_node, *right_node;
+  double cmin[3], cmax[3], c;
+  int i, j, axis, half;
+
+  if ( n == 1 )
+    return items[0].node;
+
+  for ( j = 0; j < 3; j++ )
+  {
+    cmin[j] = cmax[j] = items[0].node->min[j] + items[0].node->max[j];
+    for ( i = 1; i < n; i++ )
+    {
+      c = items[i].node->min[j] + items[i].node->max[j];
+      if ( c < cmin[j] ) cmin[j] = c;
+      if ( c > cmax[j] ) cmax[j] = c;
+    }
+  }
+  axis = 0;
+  for ( j = 1; j < 3; j++ )
+  {
+    if ( cmax[j] - cmin[j] > cmax[axis] - cmin[axis] )
+      axis = j;
+  }
+
+  for ( i = 0; i < n; i++ )
+    items[i].key = items[i].node->min[axis] + items[i].node->max[axis];
+  half = n / 2;
+  aabb_select(items, 0, n - 1, half);
+
+  left_node = aabb_tree_split_nodes(ctx, items, half, block, next);
+  right_node = aabb_tree_split_nodes(ctx, items + half, n - half, block, next);
+  return aabb_node_internal_init(ctx, &(block[--(*next)]), left_node, right_node);
+}
+
+RTAABBTREE* rtgeom_aabb_tree_create(const RTCTX *ctx, const RTGEOM *geom)
+{
+  AABB_TREE_BUILDER b;
+  AABB_SORT_ITEM *items;
+  AABB_NODE *block, *node;
+  RTAABBTREE *tree;
+  int i, j, k, next;
+
+  b.ncomps = 0;
+  b.maxcomps = 8;
+  b.comps = rtalloc(ctx, sizeof(AABB_COMP) * b.maxcomps);
+
+  tree = rtalloc(ctx, sizeof(RTAABBTREE));
+  tree->geom = geom;
+  tree->tree = NULL;
+
+  if ( aabb_tree_builder_add_geom(ctx, &b, geom) == RT_FAILURE )
+  {
+    /* Not indexable, distances will be computed the old way */
+    for ( i = 0; i < b.ncomps; i++ )
+      aabb_comp_free(ctx, &(b.comps[i]));
+    b.ncomps = 0;
+  }
+
+  if ( b.ncomps > 0 )
+  {
+    /* Same layout as the edge trees, leaves last */
+    items = rtalloc(ctx, sizeof(AABB_SORT_ITEM) * b.ncomps);
+    block = rtalloc(ctx, sizeof(AABB_NODE) * (2 * b.ncomps - 1));
+    next = b.ncomps - 1;
+    for ( i = 0; i < b.ncomps; i++ )
+    {
+      const AABB_COMP *comp = &(b.comps[i]);
+      node = &(block[next + i]);
+      node->left_node = node->right_node = NULL;
+      node->index = i;
+      for ( k = 0; k < 3; k++ )
+      {
+        node->min[k] = comp->trees[0]->min[k];
+        node->max[k] = comp->trees[0]->max[k];
+      }
+      for ( j = 1; j < comp->nrings; j++ )
+      {
+        if ( ! comp->trees[j] )
+          continue;
+        for ( k = 0; k < 3; k++ )
+        {
+          node->min[k] = FP_MIN(node->min[k], comp->trees[j]->min[k]);
+          node->max[k] = FP_MAX(node->max[k], comp->trees[j]->max[k]);
+        }
+      }
+      items[i].node = node;
+    }
+    tree->tree = aabb_tree_split_nodes(ctx, items, b.ncomps, block, &next);
+    rtfree(ctx, items);
+  }
+
+  tree->ncomps = b.ncomps;
+  tree->comps = b.comps;
+  return tree;
+}
+
+void rtgeom_aabb_tree_destroy(const RTCTX *ctx, RTAABBTREE *tree)
+{
+  int i;
+
+  if ( tree->tree )
+    aabb_tree_free(ctx, tree->tree);
+  for ( i = 0; i < tree->ncomps; i++ )
+    aabb_comp_free(ctx, &(tree->comps[i]));
+  rtfree(ctx, tree->comps);
+  rtfree(ctx, tree);
+}
@@ -0,0 +1,82 @@
+/**********************************************************************
+ *
+ * rttopo - topology library
+ * http://git.osgeo.org/gitea/rttopo/librttopo
+ *
+ * rttopo is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 2 of the License, or
+ * (at your option) any later version.
+ *
+ * rttopo is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with rttopo.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ **********************************************************************/
+
+
+#ifndef _RTTREE3D_H
+#define _RTTREE3D_H 1
+
+#include "measures3d.h"
+
+/**
+* Node of a 3D axis-aligned bounding box hierarchy, the Z-aware
+* counterpart of RECT_NODE. Bounds are indexed by axis (0 = x,
+* 1 = y, 2 = z).
+*
+* Leaves have no children. In an edge tree a leaf covers the edge
+* starting at vertex index of its point array, or that single vertex
+* for an array of one point. In a component tree it covers the
+* component numbered index.
+*/
+typedef struct aabb_node
+{
+  double min[3];
+  double max[3];
+  struct aabb_node *left_node;
+  struct aabb_node *right_node;
+  int index;
+} AABB_NODE;
+
+void aabb_tree_free(const RTCTX *ctx, AABB_NODE *node);
+AABB_NODE* aabb_tree_new(const RTCTX *ctx, const RTPOINTARRAY *pa);
+double aabb_node_distance(const RTCTX *ctx, const AABB_NODE *n1, const AABB_NODE *n2);
+
+/**
+* A point, line or polygon of an indexed geometry: the edge tree
+* of each of its point arrays, shell first, and for polygons the
+* plane of the shell, computed once.
+*/
+typedef struct
+{
+  int type;                /* RTPOINTTYPE, RTLINETYPE or RTPOLYGONTYPE */
+  int nrings;
+  RTPOINTARRAY **rings;    /* the only array of points and lines */
+  AABB_NODE **trees;       /* NULL for empty arrays */
+  PLANE3D plane;
+  double pvlength;         /* length of plane.pv */
+} AABB_COMP;
+
+/**
+* Indexed representation of a whole geometry for 3D distances,
+* a box hierarchy over its components, each indexing its edges.
+*
+* Components point into the point arrays of the source geometry,
+* which must then outlive the tree.
+*/
+struct RTAABBTREE
+{
+  const RTGEOM *geom;     /* source geometry */
+  AABB_NODE *tree;        /* NULL if empty or not indexable */
+  int ncomps;
+  AABB_COMP *comps;
+};
+
+int aabb_comp_contains_point(const RTCTX *ctx, const AABB_COMP *comp, const RTPOINT3DZ *p);
+
+#endif /* _RTTREE3D_H */
@@ -138,6 +138,435 @@ default_errorreporter(const char *fmt, va_list ap, void *arg)
   exit(1);
 }
 
+static void *
+default_allocator_r(size_t size, void *arg)
+{
+  return malloc(size);
+}
+
+static void
+default_freeor_r(void *mem, void *arg)
+{
+  free(mem);
+}
+
+static void *
+default_reallocator_r(void *mem, size_t size, void *arg)
+{
+  return realloc(mem, size);
+}
+
+/*
+ * Adapters giving the callbacks of rtgeom_init the signature of
+ * those of rtgeom_init_r. Their argument is the context.
+ */
+
+static void *
+plain_allocator(size_t size, void *arg)
+{
+  return ((RTCTX *)arg)->alloc_plain(size);
+}
+
+static void *
+plain_reallocator(void *mem, size_t size, void *arg)
+{
+  return ((RTCTX *)arg)->realloc_plain(mem, size);
+}
+
+static void
+plain_freeor(void *mem, void *arg)
+{
+  ((RTCTX *)arg)->free_plain(mem);
+}
+
+/*
+ * Arena allocator
+ *
+ * Allocations are carved out of chunks obtained with malloc, each
+ * preceded by its size so that rtrealloc can copy it. Only the most
+ * recent allocation can be grown in place or given back, releasing
+ * anything else is a no-op until rtgeom_arena_reset.
+ */
+
+#define ARENA_ALIGN 16
+#define ARENA_ROUND(x) (((x) + ARENA_ALIGN - 1) & ~((size_t)ARENA_ALIGN - 1))
+#define ARENA_DEFAULT_BLOCK 65536
+/* room taken by the size stored before each allocation */
+#define ARENA_HEADER ARENA_ROUND(sizeof(size_t))
+
+typedef struct RTARENA_CHUNK_T
+{
+  struct RTARENA_CHUNK_T *next;
+  size_t size;   /* usable bytes */
+  size_t used;
+} RTARENA_CHUNK;
+
+#define ARENA_CHUNK_DATA(c) ((char *)(c) + ARENA_ROUND(sizeof(RTARENA_CHUNK)))
+
+struct RTARENA_T
+{
+  RTARENA_CHUNK *head;  /* chunk currently carved, others follow */
+  size_t block_size;
+  char *last;           /* most recent allocation in head, or NULL */
+};
+
+static RTARENA_CHUNK *
+arena_chunk_new(size_t size)
+{
+  RTARENA_CHUNK *c = malloc(ARENA_ROUND(sizeof(RTARENA_CHUNK)) + size);
+  if ( ! c ) return NULL;
+  c->next = NULL;
+  c->size = size;
+  c->used = 0;
+  return c;
+}
+
+static void *
+arena_allocator(size_t size, void *arg)
+{
+  struct RTARENA_T *arena = ((RTCTX *)arg)->arena;
+  size_t need = ARENA_HEADER + ARENA_ROUND(size);
+  RTARENA_CHUNK *c = arena->head;
+  char *mem;
+
+  if ( ! c || c->size - c->used < need )
+  {
+    if ( need > arena->block_size && c )
+    {
+      /* A chunk of its own, kept behind the one being carved */
+      RTARENA_CHUNK *big = arena_chunk_new(need);
+      if ( ! big ) return NULL;
+      big->used = need;
+      big->next = c->next;
+      c->next = big;
+      mem = ARENA_CHUNK_DATA(big) + ARENA_HEADER;
+      *(size_t *)(mem - ARENA_HEADER) = size;
+      return mem;
+    }
+    c = arena_chunk_new(need > arena->block_size ? need : arena->block_size);
+    if ( ! c ) return NULL;
+    c->next = arena->head;
+    arena->head = c;
+  }
+
+  mem = ARENA_CHUNK_DATA(c) + c->used + ARENA_HEADER;
+  *(size_t *)(mem - ARENA_HEADER) = size;
+  c->used += need;
+  arena->last = mem;
+  return mem;
+}
+
+static void *
+arena_reallocator(void *mem, size_t size, void *arg)
+{
+  struct RTARENA_T *arena = ((RTCTX *)arg)->arena;
+  size_t oldsize;
+  void *ret;
+
+  if ( ! mem ) return arena_allocator(size, arg);
+  oldsize = *(size_t *)((char *)mem - ARENA_HEADER);
+
+  if ( (char *)mem == arena->last )
+  {
+    RTARENA_CHUNK *c = arena->head;
+    size_t start = (char *)mem - ARENA_CHUNK_DATA(c);
+    if ( start + ARENA_ROUND(size) <= c->size )
+    {
+      c->used = start + ARENA_ROUND(size);
+      *(size_t *)((char *)mem - ARENA_HEADER) = size;
+      return mem;
+    }
+  }
+  else if ( size <= oldsize )
+  {
+    *(size_t *)((char *)mem - ARENA_HEADER) = size;
+    return mem;
+  }
+
+  ret = arena_allocator(size, arg);
+  if ( ret ) memcpy(ret, mem, oldsize < size ? oldsize : size);
+  return ret;
+}
+
+static void
+arena_freeor(void *mem, void *arg)
+{
+  struct RTARENA_T *arena = ((RTCTX *)arg)->arena;
+
+  /* Only the most recent allocation can be given back */
+  if ( mem && (char *)mem == arena->last )
+  {
+    arena->head->used = (char *)mem - ARENA_HEADER - ARENA_CHUNK_DATA(arena->head);
+    arena->last = NULL;
+  }
+}
+
+static void
+arena_release(struct RTARENA_T *arena, int keep_one)
+{
+  RTARENA_CHUNK *c = arena->head, *next, *kept = NULL;
+
+  for ( ; c; c = next )
+  {
+    next = c->next;
+    if ( keep_one && ! kept && c->size == arena->block_size )
+    {
+      kept = c;
+      continue;
+    }
+    free(c);
+  }
+  if ( kept )
+  {
+    kept->next = NULL;
+    kept->used = 0;
+  }
+  arena->head = kept;
+  arena->last = NULL;
+}
+
+/*
+ * Pool allocator
+ *
+ * Small requests, such as geometry headers and short point lists,
+ * are served from per size class freelists refilled by carving
+ * slabs obtained from the underlying allocator. Every block is
+ * preceded by a header telling its class, or that it was too large
+ * for the pool and comes straight from the underlying allocator.
+ */
+
+static const size_t pool_class_size[RTPOOL_NCLASSES] =
+  { 16, 32, 48, 64, 96, 128, 192, 256, 384, 512 };
+
+#define POOL_HEADER ARENA_HEADER
+#define POOL_LARGE RTPOOL_NCLASSES
+#define POOL_SLAB_SIZE 65536
+#define POOL_CLASS(mem) (*(size_t *)((char *)(mem) - POOL_HEADER))
+
+typedef struct RTPOOL_SLAB_T
+{
+  struct RTPOOL_SLAB_T *next;
+} RTPOOL_SLAB;
+
+#define POOL_SLAB_DATA(s) ((char *)(s) + ARENA_ROUND(sizeof(RTPOOL_SLAB)))
+
+struct RTPOOL_T
+{
+  /* underlying allocator */
+  rtallocator_r alloc;
+  rtreallocator_r realloc;
+  rtfreeor_r free;
+  void *arg;
+
+  void *freelist[RTPOOL_NCLASSES];
+  RTPOOL_SLAB *slabs;
+  char *slab_cur;  /* first uncarved byte of the last slab */
+  char *slab_end;
+  RTPOOLSTATS stats;
+};
+
+static int
+pool_class(size_t size)
+{
+  int c = 0;
+  while ( c < RTPOOL_NCLASSES && pool_class_size[c] < size ) c++;
+  return c;
+}
+
+static void *
+pool_allocator(size_t size, void *arg)
+{
+  struct RTPOOL_T *pool = ((RTCTX *)arg)->pool;
+  int c = pool_class(size);
+  size_t need;
+  char *mem;
+
+  if ( c == POOL_LARGE )
+  {
+    mem = pool->alloc(POOL_HEADER + size, pool->arg);
+    if ( ! mem ) return NULL;
+    mem += POOL_HEADER;
+    POOL_CLASS(mem) = POOL_LARGE;
+    pool->stats.large++;
+    return mem;
+  }
+
+  pool->stats.allocations++;
+  if ( pool->freelist[c] )
+  {
+    mem = pool->freelist[c];
+    pool->freelist[c] = *(void **)mem;
+    pool->stats.reused++;
+    pool->stats.idle -= pool_class_size[c];
+    return mem;
+  }
+
+  need = POOL_HEADER + pool_class_size[c];
+  if ( (size_t)(pool->slab_end - pool->slab_cur) < need )
+  {
+    RTPOOL_SLAB *slab = pool->alloc(POOL_SLAB_SIZE, pool->arg);
+    if ( ! slab ) return NULL;
+    slab->next = pool->slabs;
+    pool->slabs = slab;
+    pool->slab_cur = POOL_SLAB_DATA(slab);
+    pool->slab_end = (char *)slab + POOL_SLAB_SIZE;
+    pool->stats.reserved += POOL_SLAB_SIZE;
+  }
+  mem = pool->slab_cur + POOL_HEADER;
+  pool->slab_cur += need;
+  POOL_CLASS(mem) = c;
+  return mem;
+}
+
+static void
+pool_freeor(void *mem, void *arg)
+{
+  struct RTPOOL_T *pool = ((RTCTX *)arg)->pool;
+  size_t c;
+
+  if ( ! mem ) return;
+  c = POOL_CLASS(mem);
+  if ( c == POOL_LARGE )
+  {
+    pool->free((char *)mem - POOL_HEADER, pool->arg);
+    return;
+  }
+  *(void **)mem = pool->freelist[c];
+  pool->freelist[c] = mem;
+  pool->stats.releases++;
+  pool->stats.idle += pool_class_size[c];
+}
+
+static void *
+pool_reallocator(void *mem, size_t size, void *arg)
+{
+  struct RTPOOL_T *pool = ((RTCTX *)arg)->pool;
+  size_t c, oldsize;
+  char *ret;
+
+  if ( ! mem ) return pool_allocator(size, arg);
+  c = POOL_CLASS(mem);
+
+  if ( c == POOL_LARGE )
+  {
+    /* Stay out of the pool, even when shrinking */
+    ret = pool->realloc((char *)mem - POOL_HEADER, POOL_HEADER + size, pool->arg);
+    return ret ? ret + POOL_HEADER : NULL;
+  }
+
+  oldsize = pool_class_size[c];
+  if ( size <= oldsize && ( c == 0 || size > pool_class_size[c-1] ) )
+    return mem;
+
+  ret = pool_allocator(size, arg);
+  if ( ! ret ) return NULL;
+  memcpy(ret, mem, oldsize < size ? oldsize : size);
+  pool_freeor(mem, arg);
+  return ret;
+}
+
+static void
+pool_release(struct RTPOOL_T *pool)
+{
+  RTPOOL_SLAB *slab, *next;
+
+  for ( slab = pool->slabs; slab; slab = next )
+  {
+    next = slab->next;
+    pool->free(slab, pool->arg);
+  }
+}
+
+/*
+ * Memory accounting
+ *
+ * Stacked on top of any of the above, it precedes every block with
+ * its size so that releases can be subtracted from the counters.
+ * The callbacks it wraps are kept in the context.
+ */
+
+#define ACCT_HEADER ARENA_HEADER
+#define ACCT_SIZE(mem) (*(size_t *)((char *)(mem) - ACCT_HEADER))
+
+static int
+acct_admit(RTCTX *ctx, size_t size, size_t grow)
+{
+  if ( size > (size_t)-1 - ACCT_HEADER ||
+       ( ctx->mem_limit && grow &&
+         ( ctx->mem_stats.current >= ctx->mem_limit ||
+           grow > ctx->mem_limit - ctx->mem_stats.current ) ) )
+  {
+    ctx->mem_stats.failures++;
+    rterror(ctx, "Memory limit of %lu bytes exceeded requesting %lu bytes",
+            (unsigned long)ctx->mem_limit, (unsigned long)size);
+    return RT_FALSE;
+  }
+  return RT_TRUE;
+}
+
+static void
+acct_count(RTCTX *ctx, size_t grow)
+{
+  ctx->mem_stats.allocations++;
+  ctx->mem_stats.current += grow;
+  if ( ctx->mem_stats.current > ctx->mem_stats.peak )
+    ctx->mem_stats.peak = ctx->mem_stats.current;
+}
+
+static void *
+acct_allocator(size_t size, void *arg)
+{
+  RTCTX *ctx = arg;
+  char *mem;
+
+  if ( ! acct_admit(ctx, size, size) ) return NULL;
+  mem = ctx->acct_alloc(ACCT_HEADER + size, ctx->acct_arg);
+  if ( ! mem ) return NULL;
+  mem += ACCT_HEADER;
+  ACCT_SIZE(mem) = size;
+  acct_count(ctx, size);
+  return mem;
+}
+
+static void
+acct_freeor(void *mem, void *arg)
+{
+  RTCTX *ctx = arg;
+
+  if ( ! mem ) return;
+  ctx->mem_stats.current -= ACCT_SIZE(mem);
+  ctx->acct_free((char *)mem - ACCT_HEADER, ctx->acct_arg);
+}
+
+static void *
+acct_reallocator(void *mem, size_t size, void *arg)
+{
+  RTCTX *ctx = arg;
+  size_t oldsize;
+  char *ret;
+
+  if ( ! mem ) return acct_allocator(size, arg);
+
+  oldsize = ACCT_SIZE(mem);
+  if ( ! acct_admit(ctx, size, size > oldsize ? size - oldsize : 0) )
+    return NULL;
+  ret = ctx->acct_realloc((char *)mem - ACCT_HEADER, ACCT_HEADER + size, ctx->acct_arg);
+  if ( ! ret ) return NULL;
+  ret += ACCT_HEADER;
+  ACCT_SIZE(ret) = size;
+  ctx->mem_stats.current -= oldsize;
+  acct_count(ctx, size);
+  return ret;
+}
+
+static void
+rtgeom_init_loggers(RTCTX *ctx)
+{
+  ctx->notice_logger = default_noticereporter;
+  ctx->error_logger = default_errorreporter;
+  ctx->debug_logger = default_debuglogger;
+}
+
 RTCTX *
 rtgeom_init(rtallocator allocator,
                    rtreallocator reallocator,
@@ -148,27 +577,186 @@ rtgeom_init(rtallocator allocator,
 
   memset(ctx, '\0', sizeof(RTCTX));
 
-  ctx->rtalloc_var = default_allocator;
-  ctx->rtrealloc_var = default_reallocator;
-  ctx->rtfree_var = default_freeor;
+  ctx->alloc_plain = allocator ? allocator : default_allocator;
+  ctx->realloc_plain = reallocator ? reallocator : default_reallocator;
+  ctx->free_plain = freeor ? freeor : default_freeor;
 
-  if ( allocator ) ctx->rtalloc_var = allocator;
-  if ( reallocator ) ctx->rtrealloc_var = reallocator;
-  if ( freeor ) ctx->rtfree_var = freeor;
+  ctx->rtalloc_var = plain_allocator;
+  ctx->rtrealloc_var = plain_reallocator;
+  ctx->rtfree_var = plain_freeor;
+  ctx->alloc_arg = ctx;
 
-  ctx->notice_logger = default_noticereporter;
-  ctx->error_logger = default_errorreporter;
-  ctx->debug_logger = default_debuglogger;
+  rtgeom_init_loggers(ctx);
 
   return ctx;
 }
 
+RTCTX *
+rtgeom_init_r(rtallocator_r allocator,
+                   rtreallocator_r reallocator,
+                   rtfreeor_r freeor,
+                   void *arg)
+{
+  RTCTX *ctx = allocator ? allocator(sizeof(RTCTX), arg)
+                 : default_allocator(sizeof(RTCTX));
+
+  memset(ctx, '\0', sizeof(RTCTX));
+
+  ctx->rtalloc_var = allocator ? allocator : default_allocator_r;
+  ctx->rtrealloc_var = reallocator ? reallocator : default_reallocator_r;
+  ctx->rtfree_var = freeor ? freeor : default_freeor_r;
+  ctx->alloc_arg = arg;
+
+  rtgeom_init_loggers(ctx);
+
+  return ctx;
+}
+
+RTCTX *
+rtgeom_init_pool(rtallocator_r allocator,
+                   rtreallocator_r reallocator,
+                   rtfreeor_r freeor,
+                   void *arg)
+{
+  RTCTX *ctx = rtgeom_init_r(allocator, reallocator, freeor, arg);
+  struct RTPOOL_T *pool = ctx->rtalloc_var(sizeof(struct RTPOOL_T), ctx->alloc_arg);
+
+  memset(pool, '\0', sizeof(struct RTPOOL_T));
+  pool->alloc = ctx->rtalloc_var;
+  pool->realloc = ctx->rtrealloc_var;
+  pool->free = ctx->rtfree_var;
+  pool->arg = ctx->alloc_arg;
+
+  ctx->pool = pool;
+  ctx->rtalloc_var = pool_allocator;
+  ctx->rtrealloc_var = pool_reallocator;
+  ctx->rtfree_var = pool_freeor;
+  ctx->alloc_arg = ctx;
+
+  return ctx;
+}
+
+void
+rtgeom_pool_stats(const RTCTX *ctx, RTPOOLSTATS *stats)
+{
+  if ( ! ctx->pool )
+  {
+    memset(stats, '\0', sizeof(RTPOOLSTATS));
+    return;
+  }
+  *stats = ctx->pool->stats;
+}
+
+void
+rtgeom_enable_memory_accounting(RTCTX *ctx, size_t limit)
+{
+  ctx->mem_limit = limit;
+  if ( ctx->acct_alloc ) return;
+
+  ctx->acct_alloc = ctx->rtalloc_var;
+  ctx->acct_realloc = ctx->rtrealloc_var;
+  ctx->acct_free = ctx->rtfree_var;
+  ctx->acct_arg = ctx->alloc_arg;
+
+  ctx->rtalloc_var = acct_allocator;
+  ctx->rtrealloc_var = acct_reallocator;
+  ctx->rtfree_var = acct_freeor;
+  ctx->alloc_arg = ctx;
+}
+
+void
+rtgeom_set_memory_limit(RTCTX *ctx, size_t limit)
+{
+  if ( ! ctx->acct_alloc )
+  {
+    rterror(ctx, "rtgeom_set_memory_limit: context has no memory accounting");
+    return;
+  }
+  ctx->mem_limit = limit;
+}
+
+void
+rtgeom_memory_stats(const RTCTX *ctx, RTMEMSTATS *stats)
+{
+  *stats = ctx->mem_stats;
+}
+
+void
+rtgeom_memory_reset_peak(RTCTX *ctx)
+{
+  ctx->mem_stats.peak = ctx->mem_stats.current;
+}
+
+RTCTX *
+rtgeom_init_arena(size_t block_size)
+{
+  RTCTX *ctx = rtgeom_init(NULL, NULL, NULL);
+  struct RTARENA_T *arena = default_allocator(sizeof(struct RTARENA_T));
+
+  arena->head = NULL;
+  arena->last = NULL;
+  arena->block_size = ARENA_ROUND(block_size ? block_size : ARENA_DEFAULT_BLOCK);
+
+  ctx->arena = arena;
+  ctx->rtalloc_var = arena_allocator;
+  ctx->rtrealloc_var = arena_reallocator;
+  ctx->rtfree_var = arena_freeor;
+  ctx->alloc_arg = ctx;
+
+  return ctx;
+}
+
+void
+rtgeom_arena_reset(RTCTX *ctx)
+{
+  if ( ! ctx->arena )
+  {
+    rterror(ctx, "rtgeom_arena_reset: context has no arena");
+    return;
+  }
+
+  /* Scratch memory lived in the arena too */
+  ctx->dist2d_scratch = NULL;
+  ctx->dist2d_scratch_size = 0;
+  ctx->mem_stats.current = 0;
+
+  arena_release(ctx->arena, RT_TRUE);
+}
+
 void
 rtgeom_finish(RTCTX *ctx)
 {
   if (ctx->gctx != NULL)
     GEOS_finish_r(ctx->gctx);
-  ctx->rtfree_var(ctx);
+  if (ctx->arena != NULL)
+  {
+    /* The context itself comes from malloc */
+    arena_release(ctx->arena, RT_FALSE);
+    default_freeor(ctx->arena);
+    default_freeor(ctx);
+    return;
+  }
+  /* Large scratch buffers of pool contexts are not part of its slabs */
+  if (ctx->dist2d_scratch != NULL)
+    ctx->rtfree_var(ctx->dist2d_scratch, ctx->alloc_arg);
+  if (ctx->pool != NULL)
+  {
+    /* Context and pool come from the underlying allocator */
+    struct RTPOOL_T *pool = ctx->pool;
+    rtfreeor_r freeor = pool->free;
+    void *arg = pool->arg;
+    pool_release(pool);
+    freeor(pool, arg);
+    freeor(ctx, arg);
+    return;
+  }
+  if (ctx->acct_alloc != NULL)
+  {
+    /* The context was allocated before accounting started */
+    ctx->acct_free(ctx, ctx->acct_arg);
+    return;
+  }
+  ctx->rtfree_var(ctx, ctx->alloc_arg);
 }
 
 void
@@ -247,7 +835,7 @@ rttype_name(const RTCTX *ctx, uint8_t type)
 void *
 rtalloc(const RTCTX *ctx, size_t size)
 {
-  void *mem = ctx->rtalloc_var(size);
+  void *mem = ctx->rtalloc_var(size, ctx->alloc_arg);
   RTDEBUGF(ctx, 5, "rtalloc: %d@%p", size, mem);
   return mem;
 }
@@ -256,13 +844,13 @@ void *
 rtrealloc(const RTCTX *ctx, void *mem, size_t size)
 {
   RTDEBUGF(ctx, 5, "rtrealloc: %d@%p", size, mem);
-  return ctx->rtrealloc_var(mem, size);
+  return ctx->rtrealloc_var(mem, size, ctx->alloc_arg);
 }
 
 void
 rtfree(const RTCTX *ctx, void *mem)
 {
-  ctx->rtfree_var(mem);
+  ctx->rtfree_var(mem, ctx->alloc_arg);
 }
 
 /*